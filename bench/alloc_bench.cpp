@@ -0,0 +1,92 @@
+//
+// Created by henryco on 17/10/26.
+//
+
+#include "../data/alloc/lalloc.h"
+#include "../data/alloc/rbtalloc.h"
+#include "../data/alloc/slab.h"
+#include "../data/alloc/stackarena.h"
+#include <benchmark/benchmark.h>
+#include <algorithm>
+#include <random>
+#include <vector>
+
+namespace {
+
+    constexpr int OBJECTS_N    = 256;
+    constexpr int OBJECT_MAX_B = 16 + 15 * 24;
+
+    std::size_t object_size_(const int i) {
+        return 16 + ((i * 37) % 16) * 24;
+    }
+
+    struct stackarena_target : ex::data::stackarena::allocator {
+        stackarena_target() :
+            allocator(OBJECT_MAX_B, 1 MB) {
+        }
+    };
+
+    struct shim_target {
+        ex::data::allocator compat() {
+            return {};
+        }
+    };
+
+    /**
+     * Allocates a batch of mixed size objects and frees it in reverse order.
+     * Allocators are driven through their compat() vtable, the way containers use them.
+     */
+    template <typename T>
+    void BM_alloc_lifo(benchmark::State &state) {
+        T                   target;
+        ex::data::allocator allocator = target.compat();
+
+        void *objects[OBJECTS_N];
+        for (auto _ : state) {
+            for (int i = 0; i < OBJECTS_N; ++i)
+                objects[i] = allocator.malloc(&allocator, object_size_(i), 8);
+            benchmark::DoNotOptimize(objects);
+            for (int i = OBJECTS_N - 1; i >= 0; --i)
+                allocator.free(&allocator, objects[i]);
+        }
+        state.SetItemsProcessed(state.iterations() * OBJECTS_N * 2);
+    }
+
+    /**
+     * Same batch freed in random order, so coalescing and free lists see interleaved holes
+     */
+    template <typename T>
+    void BM_alloc_random_free(benchmark::State &state) {
+        T                   target;
+        ex::data::allocator allocator = target.compat();
+
+        std::vector<int> order(OBJECTS_N);
+        for (int i = 0; i < OBJECTS_N; ++i)
+            order[i] = i;
+        std::shuffle(order.begin(), order.end(), std::mt19937(42));
+
+        void *objects[OBJECTS_N];
+        for (auto _ : state) {
+            for (int i = 0; i < OBJECTS_N; ++i)
+                objects[i] = allocator.malloc(&allocator, object_size_(i), 8);
+            benchmark::DoNotOptimize(objects);
+            for (const int i : order)
+                allocator.free(&allocator, objects[i]);
+        }
+        state.SetItemsProcessed(state.iterations() * OBJECTS_N * 2);
+    }
+}
+
+BENCHMARK(BM_alloc_lifo<ex::data::lalloc::allocator>);
+BENCHMARK(BM_alloc_lifo<ex::data::rbtalloc::allocator>);
+BENCHMARK(BM_alloc_lifo<ex::data::rbtalloc::compact_allocator>);
+BENCHMARK(BM_alloc_lifo<ex::data::slab::allocator>);
+BENCHMARK(BM_alloc_lifo<stackarena_target>);
+BENCHMARK(BM_alloc_lifo<shim_target>);
+
+BENCHMARK(BM_alloc_random_free<ex::data::lalloc::allocator>);
+BENCHMARK(BM_alloc_random_free<ex::data::rbtalloc::allocator>);
+BENCHMARK(BM_alloc_random_free<ex::data::rbtalloc::compact_allocator>);
+BENCHMARK(BM_alloc_random_free<ex::data::slab::allocator>);
+BENCHMARK(BM_alloc_random_free<stackarena_target>);
+BENCHMARK(BM_alloc_random_free<shim_target>);
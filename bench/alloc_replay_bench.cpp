@@ -0,0 +1,262 @@
+//
+// Created by henryco on 17/10/26.
+//
+
+#include "../data/alloc/alloctrace.h"
+#include "../data/alloc/lalloc.h"
+#include "../data/alloc/rbtalloc.h"
+#include "../data/alloc/stackarena.h"
+#include <benchmark/benchmark.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+    using ex::data::alloctrace::trace_op;
+    using ex::data::alloctrace::trace_record;
+
+    /**
+     * Records a synthetic workload through the recorder: small short lived objects,
+     * growing buffers (realloc) and rare large blocks, freed in random order
+     */
+    std::vector<trace_record> trace_synthetic_() {
+        const std::string path = (std::filesystem::temp_directory_path() / "limbo_replay_synthetic.trace").string();
+        {
+            ex::data::alloctrace::recorder recorder({}, path.c_str());
+            ex::data::allocator            allocator = recorder.compat();
+
+            std::mt19937        random(11);
+            std::vector<void *> live;
+            for (int i = 0; i < 200000; ++i) {
+                if (!live.empty() && (live.size() >= 8192 || random() % 100 < 45)) {
+                    const std::size_t at = random() % live.size();
+                    if (random() % 8 == 0) {
+                        live[at] = allocator.realloc(&allocator, live[at], 64 + random() % 8192);
+                        continue;
+                    }
+                    allocator.free(&allocator, live[at]);
+                    live[at] = live.back();
+                    live.pop_back();
+                    continue;
+                }
+
+                const u_int32_t kind   = random() % 100;
+                const u_int32_t size_b = kind < 80 ? 16 + random() % 112
+                                       : kind < 98 ? 256 + random() % 3840
+                                                   : 16384 + random() % 49152;
+                live.push_back(allocator.malloc(&allocator, size_b, std::size_t(8) << (random() % 2)));
+            }
+            for (void *ptr : live)
+                allocator.free(&allocator, ptr);
+        }
+        std::vector<trace_record> trace = ex::data::alloctrace::load(path.c_str());
+        std::filesystem::remove(path);
+        return trace;
+    }
+
+    /**
+     * LIMBO_TRACE names a recorded trace file, a synthetic one is used otherwise
+     */
+    const std::vector<trace_record> &trace_() {
+        static const std::vector<trace_record> trace = [] {
+            if (const char *path = std::getenv("LIMBO_TRACE"))
+                return ex::data::alloctrace::load(path);
+            return trace_synthetic_();
+        }();
+        return trace;
+    }
+
+    u_int32_t trace_max_size_() {
+        u_int32_t max_b = 0;
+        for (const trace_record &record : trace_())
+            max_b = std::max(max_b, record.size_b);
+        return max_b;
+    }
+
+    /**
+     * VmRSS or VmHWM (peak) of this process in bytes
+     */
+    long rss_(const char *field) {
+        std::ifstream status("/proc/self/status");
+        for (std::string line; std::getline(status, line);)
+            if (line.rfind(field, 0) == 0)
+                return std::atol(line.c_str() + std::strlen(field) + 1) * 1024;
+        return 0;
+    }
+
+    /**
+     * Hands glibc's cached memory back first, so a glibc backed replay does not start on resident pages
+     */
+    void rss_peak_reset_() {
+        #if defined(__GLIBC__)
+        ::malloc_trim(0);
+        #endif
+        std::ofstream("/proc/self/clear_refs") << "5";
+    }
+
+    /**
+     * One block size for the whole trace, reallocs within the block stay in place
+     */
+    struct stackarena_target : ex::data::stackarena::allocator {
+
+        stackarena_target() :
+            allocator((trace_max_size_() + 63) / 64 * 64, 64 MB) {
+        }
+
+        ex::data::allocator compat() {
+            ex::data::allocator vtable = allocator::compat();
+            vtable.realloc = &stackarena_target::realloc_;
+            return vtable;
+        }
+
+        static void *realloc_(void *this_, void *ptr, const std::size_t size_new_b) {
+            const auto *self = static_cast<stackarena_target *>(static_cast<const ex::data::allocator *>(this_)->instance);
+            if (size_new_b > self->block_s)
+                abort_("Reallocation past the arena block size");
+            return ptr;
+        }
+    };
+
+    struct shim_target {
+        ex::data::allocator compat() {
+            return {};
+        }
+    };
+
+    /**
+     * Plain glibc, no usable size accounting
+     */
+    struct glibc_target {
+
+        ex::data::allocator compat() {
+            return { .malloc     = &glibc_target::malloc_,
+                     .realloc    = &glibc_target::realloc_,
+                     .free       = &glibc_target::free_,
+                     .try_expand = &glibc_target::try_expand_,
+                     .size_total = &glibc_target::size_,
+                     .size_used  = &glibc_target::size_ };
+        }
+
+        static void *malloc_(void *, const std::size_t size_new_b, const std::size_t alignment_b) {
+            if (alignment_b <= alignof(std::max_align_t))
+                return ::malloc(size_new_b);
+            return ::aligned_alloc(alignment_b, (size_new_b + alignment_b - 1) / alignment_b * alignment_b);
+        }
+
+        static void *realloc_(void *, void *ptr, const std::size_t size_new_b) {
+            return ::realloc(ptr, size_new_b);
+        }
+
+        static void free_(void *, void *ptr) {
+            ::free(ptr);
+        }
+
+        static bool try_expand_(void *, void *, std::size_t) {
+            return false;
+        }
+
+        static long size_(void *) {
+            return 0;
+        }
+    };
+
+    /**
+     * Replays the trace on a fresh allocator per iteration, every operation timed.
+     * Iteration time is the sum of the operation samples (manual time), so the memset touching
+     * each object and the setup between replays stay out of the throughput.
+     * peak_rss_b is the resident set growth over the replay,
+     * fragmentation is <b>1 - peak live bytes / peak_rss_b</b> (allocator metadata included).
+     */
+    template <typename T>
+    void BM_replay(benchmark::State &state) {
+        const std::vector<trace_record> &trace = trace_();
+
+        u_int32_t ids_n = 0;
+        for (const trace_record &record : trace)
+            ids_n = std::max(ids_n, record.id + 1);
+
+        std::vector<double>    samples;
+        std::vector<void *>    slots(ids_n);
+        std::vector<u_int32_t> sizes(ids_n);
+        samples.reserve(trace.size());
+
+        double peak_rss_b  = 0;
+        double peak_live_b = 0;
+        for (auto _ : state) {
+            samples.clear();
+            std::fill(slots.begin(), slots.end(), nullptr);
+            std::fill(sizes.begin(), sizes.end(), 0);
+            rss_peak_reset_();
+            const long rss_b = rss_("VmRSS:");
+
+            auto               *target    = new T();
+            ex::data::allocator allocator = target->compat();
+            u_int64_t           live_b    = 0;
+            u_int64_t           peak_b    = 0;
+            double              replay_ns = 0;
+
+            for (const trace_record &record : trace) {
+                void *&ptr = slots[record.id];
+
+                const auto t0 = std::chrono::steady_clock::now();
+                switch (record.op) {
+                    case trace_op::malloc:
+                        ptr = allocator.malloc(&allocator, record.size_b, record.alignment_b);
+                        break;
+                    case trace_op::realloc:
+                        ptr = ptr == nullptr ? allocator.malloc(&allocator, record.size_b, 8)
+                                             : allocator.realloc(&allocator, ptr, record.size_b);
+                        break;
+                    case trace_op::free:
+                        if (ptr != nullptr)
+                            allocator.free(&allocator, ptr);
+                        ptr = nullptr;
+                        break;
+                }
+                const auto   t1    = std::chrono::steady_clock::now();
+                const double op_ns = std::chrono::duration<double, std::nano>(t1 - t0).count();
+                samples.push_back(op_ns);
+                replay_ns += op_ns;
+
+                if (ptr != nullptr)
+                    std::memset(ptr, 0xA5, record.size_b); // resident like real objects
+                live_b = live_b - sizes[record.id] + record.size_b;
+                peak_b = std::max(peak_b, live_b);
+                sizes[record.id] = record.size_b;
+            }
+
+            peak_rss_b  = static_cast<double>(std::max(rss_("VmHWM:") - rss_b, 1L));
+            peak_live_b = static_cast<double>(peak_b);
+            for (void *&ptr : slots)
+                if (ptr != nullptr)
+                    allocator.free(&allocator, ptr);
+            delete target;
+            state.SetIterationTime(replay_ns * 1e-9);
+        }
+
+        std::sort(samples.begin(), samples.end());
+        const auto percentile = [&samples](const double p) {
+            return samples[static_cast<std::size_t>(p * (samples.size() - 1))];
+        };
+
+        state.counters["p50_ns"]        = percentile(.50);
+        state.counters["p99_ns"]        = percentile(.99);
+        state.counters["p999_ns"]       = percentile(.999);
+        state.counters["peak_rss_b"]    = peak_rss_b;
+        state.counters["fragmentation"] = std::max(0.0, 1.0 - peak_live_b / peak_rss_b);
+        state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(trace.size()));
+    }
+}
+
+BENCHMARK(BM_replay<ex::data::lalloc::allocator>)->Unit(benchmark::kMillisecond)->UseManualTime();
+BENCHMARK(BM_replay<ex::data::rbtalloc::allocator>)->Unit(benchmark::kMillisecond)->UseManualTime();
+BENCHMARK(BM_replay<stackarena_target>)->Unit(benchmark::kMillisecond)->UseManualTime();
+BENCHMARK(BM_replay<shim_target>)->Unit(benchmark::kMillisecond)->UseManualTime();
+BENCHMARK(BM_replay<glibc_target>)->Unit(benchmark::kMillisecond)->UseManualTime();
@@ -0,0 +1,122 @@
+//
+// Created by henryco on 17/10/26.
+//
+
+#include "../data/struct/array_map.h"
+#include "../data/struct/hash_map.h"
+#include "../data/struct/rb_map.h"
+#include "../data/struct/sorted_map.h"
+#include <benchmark/benchmark.h>
+#include <algorithm>
+#include <random>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+
+    struct std_map {
+        std::unordered_map<int, int> map;
+
+        void put(const int key, const int val) {
+            map[key] = val;
+        }
+
+        int &at(const int key) {
+            return map.at(key);
+        }
+
+        bool contains(const int key) const {
+            return map.contains(key);
+        }
+    };
+
+    /**
+     * Sorted map switched to the Eytzinger layout once filled (the first lookup builds it)
+     */
+    struct frozen_sorted_map {
+        ex::data::sorted_map<int, int> map;
+
+        void put(const int key, const int val) {
+            map.put(key, val);
+        }
+
+        int &at(const int key) {
+            freeze_();
+            return map.at(key);
+        }
+
+        bool contains(const int key) {
+            freeze_();
+            return map.contains(key);
+        }
+
+        void freeze_() {
+            if (!map.frozen())
+                map.freeze();
+        }
+    };
+
+    /**
+     * Sparse keys (multiples of a large odd number), shuffled
+     */
+    std::vector<int> keys_(const int n) {
+        std::vector<int> keys(n);
+        for (int i = 0; i < n; ++i)
+            keys[i] = i * 40503;
+        std::shuffle(keys.begin(), keys.end(), std::mt19937(42));
+        return keys;
+    }
+
+    template <typename M>
+    void BM_map_put(benchmark::State &state) {
+        const int              n    = static_cast<int>(state.range(0));
+        const std::vector<int> keys = keys_(n);
+        for (auto _ : state) {
+            M map;
+            for (const int key : keys)
+                map.put(key, key);
+            benchmark::DoNotOptimize(map.at(keys[0]));
+        }
+        state.SetItemsProcessed(state.iterations() * n);
+    }
+
+    template <typename M>
+    void BM_map_hit(benchmark::State &state) {
+        const int              n    = static_cast<int>(state.range(0));
+        const std::vector<int> keys = keys_(n);
+        M                      map;
+        for (const int key : keys)
+            map.put(key, key);
+
+        for (auto _ : state)
+            for (const int key : keys)
+                benchmark::DoNotOptimize(map.at(key));
+        state.SetItemsProcessed(state.iterations() * n);
+    }
+
+    template <typename M>
+    void BM_map_miss(benchmark::State &state) {
+        const int              n    = static_cast<int>(state.range(0));
+        const std::vector<int> keys = keys_(n);
+        M                      map;
+        for (const int key : keys)
+            map.put(key, key);
+
+        for (auto _ : state)
+            for (const int key : keys)
+                benchmark::DoNotOptimize(map.contains(key + 1));
+        state.SetItemsProcessed(state.iterations() * n);
+    }
+}
+
+#define MAP_BENCH_(fn)                                                                                                 \
+    BENCHMARK(fn<ex::data::array_map<int, int>>)->RangeMultiplier(4)->Range(16, 1024);                                 \
+    BENCHMARK(fn<ex::data::sorted_map<int, int>>)->RangeMultiplier(4)->Range(16, 16384);                               \
+    BENCHMARK(fn<frozen_sorted_map>)->RangeMultiplier(4)->Range(16, 16384);                                           \
+    BENCHMARK(fn<ex::data::rb_map<int, int>>)->RangeMultiplier(4)->Range(16, 16384);                                   \
+    BENCHMARK(fn<ex::data::hash_map<int, int>>)->RangeMultiplier(4)->Range(16, 16384);                                 \
+    BENCHMARK(fn<std_map>)->RangeMultiplier(4)->Range(16, 16384)
+
+MAP_BENCH_(BM_map_put);
+MAP_BENCH_(BM_map_hit);
+MAP_BENCH_(BM_map_miss);
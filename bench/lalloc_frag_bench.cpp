@@ -0,0 +1,74 @@
+//
+// Created by henryco on 17/10/26.
+//
+
+#include "../data/alloc/lalloc.h"
+#include <benchmark/benchmark.h>
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <vector>
+
+namespace {
+
+    constexpr int LIVE_N   = 16384;
+    constexpr int ROUNDS_N = 4096;
+
+    /**
+     * Fills heap with mixed size blocks, punches random holes in it,
+     * then measures per-operation latency of malloc/free churn on top of fragmented heap
+     */
+    void BM_lalloc_fragmented(benchmark::State &state) {
+        const std::size_t max_size_b = state.range(0);
+
+        std::vector<double> samples;
+        samples.reserve(ROUNDS_N * 2);
+
+        for (auto _ : state) {
+            state.PauseTiming();
+            auto *allocator = new ex::data::lalloc::allocator();
+            std::mt19937 random(42);
+            std::vector<void *> live(LIVE_N);
+            for (auto &ptr : live)
+                ptr = allocator->malloc(16 + random() % max_size_b, 8);
+            for (int i = 0; i < LIVE_N; i += 2) {
+                allocator->free(live[i]);
+                live[i] = nullptr;
+            }
+            state.ResumeTiming();
+
+            for (int i = 0; i < ROUNDS_N; ++i) {
+                const std::size_t idx  = random() % LIVE_N;
+                const std::size_t size = 16 + random() % (2 * max_size_b);
+                const std::size_t algn = std::size_t(8) << (random() % 3);
+
+                const auto t0 = std::chrono::steady_clock::now();
+                if (live[idx] != nullptr)
+                    allocator->free(live[idx]);
+                const auto t1 = std::chrono::steady_clock::now();
+                live[idx] = allocator->malloc(size, algn);
+                const auto t2 = std::chrono::steady_clock::now();
+
+                samples.push_back(std::chrono::duration<double, std::nano>(t1 - t0).count());
+                samples.push_back(std::chrono::duration<double, std::nano>(t2 - t1).count());
+            }
+
+            state.PauseTiming();
+            delete allocator;
+            state.ResumeTiming();
+        }
+
+        std::sort(samples.begin(), samples.end());
+        const auto percentile = [&samples](const double p) {
+            return samples[static_cast<std::size_t>(p * (samples.size() - 1))];
+        };
+
+        state.counters["p50_ns"]  = percentile(.50);
+        state.counters["p99_ns"]  = percentile(.99);
+        state.counters["p999_ns"] = percentile(.999);
+        state.counters["max_ns"]  = samples.back();
+        state.SetItemsProcessed(state.iterations() * ROUNDS_N * 2);
+    }
+}
+
+BENCHMARK(BM_lalloc_fragmented)->Arg(256)->Arg(4096)->Unit(benchmark::kMillisecond);
@@ -0,0 +1,111 @@
+//
+// Created by henryco on 17/10/26.
+//
+
+#include "../data/struct/list_map.h"
+#include "../data/struct/rb_map.h"
+#include "../data/struct/rmq_map.h"
+#include <benchmark/benchmark.h>
+#include <algorithm>
+#include <random>
+#include <vector>
+
+namespace {
+
+    std::vector<int> keys_(const int n) {
+        std::vector<int> keys(n);
+        for (int i = 0; i < n; ++i)
+            keys[i] = i;
+        std::shuffle(keys.begin(), keys.end(), std::mt19937(42));
+        return keys;
+    }
+
+    template <typename M>
+    void fill_(M &map, const std::vector<int> &keys) {
+        if constexpr (requires { map.put_back(keys[0], keys[0]); }) {
+            for (const int key : keys)
+                map.put_back(key, key);
+        }
+        else {
+            for (const int key : keys)
+                map.put(key, key);
+        }
+    }
+
+    template <typename M, bool pooled>
+    void BM_node_insert(benchmark::State &state) {
+        const std::vector<int> keys = keys_(static_cast<int>(state.range(0)));
+        for (auto _ : state) {
+            M map;
+            if (pooled)
+                map.use_pool();
+            fill_(map, keys);
+            benchmark::DoNotOptimize(map.root_);
+        }
+        state.SetItemsProcessed(state.iterations() * keys.size());
+    }
+
+    /**
+     * The map is filled while another one churns the heap, as in a long running process
+     */
+    template <typename M, bool pooled>
+    void BM_node_iterate(benchmark::State &state) {
+        const std::vector<int> keys = keys_(static_cast<int>(state.range(0)));
+        M map;
+        M noise;
+        if (pooled)
+            map.use_pool();
+        for (const int key : keys) {
+            fill_(map, std::vector<int> { key });
+            fill_(noise, std::vector<int> { key });
+        }
+        noise.clean();
+
+        for (auto _ : state) {
+            long sum = 0;
+            for (auto it = map.begin(); it != map.end(); ++it)
+                sum += (*it).val;
+            benchmark::DoNotOptimize(sum);
+        }
+        state.SetItemsProcessed(state.iterations() * keys.size());
+    }
+
+    /**
+     * Only clean() is timed, the refill is not, so the run is capped at a fixed number of rounds
+     */
+    template <typename M, bool pooled>
+    void BM_node_clean(benchmark::State &state) {
+        const std::vector<int> keys = keys_(static_cast<int>(state.range(0)));
+        M map;
+        if (pooled)
+            map.use_pool();
+        for (auto _ : state) {
+            state.PauseTiming();
+            fill_(map, keys);
+            state.ResumeTiming();
+            map.clean();
+        }
+        state.SetItemsProcessed(state.iterations() * keys.size());
+    }
+}
+
+#define NODE_BENCH_(fn, M)                                                                                             \
+    BENCHMARK(fn<M, false>)->Arg(1024)->Arg(65536);                                                                    \
+    BENCHMARK(fn<M, true>)->Arg(1024)->Arg(65536)
+
+#define NODE_CLEAN_BENCH_(M)                                                                                           \
+    BENCHMARK(BM_node_clean<M, false>)->Arg(1024)->Arg(65536)->Iterations(256);                                        \
+    BENCHMARK(BM_node_clean<M, true>)->Arg(1024)->Arg(65536)->Iterations(256)
+
+using rb_map_t   = ex::data::rb_map<int, int>;
+using rmq_map_t  = ex::data::rmq_map<int, int, int>;
+using list_map_t = ex::data::list_map<int, int>;
+
+NODE_BENCH_(BM_node_insert, rb_map_t);
+NODE_BENCH_(BM_node_insert, rmq_map_t);
+NODE_BENCH_(BM_node_insert, list_map_t);
+NODE_BENCH_(BM_node_iterate, rb_map_t);
+NODE_BENCH_(BM_node_iterate, list_map_t);
+NODE_CLEAN_BENCH_(rb_map_t);
+NODE_CLEAN_BENCH_(rmq_map_t);
+NODE_CLEAN_BENCH_(list_map_t);
@@ -0,0 +1,105 @@
+//
+// Created by henryco on 17/10/26.
+//
+
+#include "../data/alloc/provider.h"
+#include <benchmark/benchmark.h>
+#include <sys/resource.h>
+#include <chrono>
+#include <random>
+#include <vector>
+
+namespace {
+
+    constexpr std::size_t REGION_S = 256 MB;
+    constexpr int         PROBES_N = 1 << 20;
+
+    const ex::data::mem_policy policies_[] = {
+        { .huge_advice = false },
+        ex::data::mem_policy::standard(),
+        ex::data::mem_policy::huge_pages(),
+        ex::data::mem_policy::prefaulted(),
+        ex::data::mem_policy::numa_local(),
+    };
+
+    const char *policy_names_[] = {
+        "plain", "thp_advice", "hugetlb", "populate", "numa_local",
+    };
+
+    long minor_faults_() {
+        rusage usage = {};
+        ::getrusage(RUSAGE_THREAD, &usage);
+        return usage.ru_minflt;
+    }
+
+    /**
+     * Maps a region under given policy, touches every page once (first touch faults),
+     * then does random reads over the whole region (dominated by TLB misses)
+     */
+    void BM_provider_policy(benchmark::State &state) {
+        const ex::data::mem_policy &policy = policies_[state.range(0)];
+        state.SetLabel(policy_names_[state.range(0)]);
+
+        double faults   = 0;
+        double touch_ns = 0;
+        double probe_ns = 0;
+
+        for (auto _ : state) {
+            ex::data::mem_provider provider(policy);
+
+            const long faults_0 = minor_faults_();
+            const auto t0       = std::chrono::steady_clock::now();
+
+            std::size_t    size = 0;
+            unsigned char *mem  = static_cast<unsigned char *>(provider.request(REGION_S, &size));
+            for (std::size_t i = 0; i < size; i += 4 KB)
+                mem[i] = 1;
+
+            const auto t1 = std::chrono::steady_clock::now();
+            faults += static_cast<double>(minor_faults_() - faults_0);
+
+            std::mt19937_64 random(42);
+            u_int64_t       sum = 0;
+            for (int i = 0; i < PROBES_N; ++i)
+                sum += mem[random() % size];
+            benchmark::DoNotOptimize(sum);
+
+            const auto t2 = std::chrono::steady_clock::now();
+            touch_ns += std::chrono::duration<double, std::nano>(t1 - t0).count();
+            probe_ns += std::chrono::duration<double, std::nano>(t2 - t1).count();
+
+            provider.clean();
+        }
+
+        const double n = static_cast<double>(state.iterations());
+        state.counters["faults"]   = faults / n;
+        state.counters["touch_ms"] = touch_ns / n / 1e6;
+        state.counters["probe_ns"] = probe_ns / n / PROBES_N;
+    }
+
+    /**
+     * Request/release churn over a growing number of live mappings, release cost must stay flat
+     */
+    void BM_provider_release(benchmark::State &state) {
+        const int live_n = static_cast<int>(state.range(0));
+
+        ex::data::mem_policy policy = ex::data::mem_policy::standard();
+        policy.retain_b = state.range(1) ? MEM_RETAIN_LIMIT : 0;
+
+        ex::data::mem_provider provider(policy);
+        std::vector<void *>    live(live_n);
+        for (auto &ptr : live)
+            ptr = provider.request(16 KB);
+
+        std::mt19937 random(42);
+        for (auto _ : state) {
+            void *&ptr = live[random() % live_n];
+            provider.release(ptr);
+            ptr = provider.request(16 KB);
+        }
+        state.SetItemsProcessed(state.iterations());
+    }
+}
+
+BENCHMARK(BM_provider_release)->ArgsProduct({ { 64, 1024, 16384 }, { 0, 1 } });
+BENCHMARK(BM_provider_policy)->DenseRange(0, 4)->Unit(benchmark::kMillisecond);
@@ -0,0 +1,107 @@
+//
+// Created by henryco on 17/10/26.
+//
+
+#include "../data/alloc/rbtalloc.h"
+#include <benchmark/benchmark.h>
+#include <random>
+#include <vector>
+
+namespace {
+
+    struct trace_op {
+        u_int32_t slot;
+        u_int32_t size_b; // 0 frees the slot
+    };
+
+    /**
+     * Synthetic malloc/free trace: mostly small short lived objects, some mid sized buffers
+     * and rare large long lived ones, freed in random order. Ends with about <b>live_n</b> objects alive.
+     */
+    std::vector<trace_op> trace_make_(const u_int32_t ops_n, const u_int32_t live_n) {
+        std::mt19937           random(7);
+        std::vector<trace_op>  trace;
+        std::vector<u_int32_t> live;
+        std::vector<u_int32_t> slots;
+        u_int32_t              slots_n = 0;
+
+        trace.reserve(ops_n);
+        while (trace.size() < ops_n) {
+            if (!live.empty() && (live.size() >= live_n || random() % 100 < 45)) {
+                const u_int32_t at   = random() % live.size();
+                const u_int32_t slot = live[at];
+                live[at] = live.back();
+                live.pop_back();
+                slots.push_back(slot);
+                trace.push_back({ slot, 0 });
+                continue;
+            }
+
+            const u_int32_t kind   = random() % 100;
+            const u_int32_t size_b = kind < 80 ? 16 + random() % 112
+                                   : kind < 98 ? 256 + random() % 3840
+                                               : 16384 + random() % 49152;
+            u_int32_t slot = slots_n;
+            if (!slots.empty()) {
+                slot = slots.back();
+                slots.pop_back();
+            } else {
+                slots_n++;
+            }
+            live.push_back(slot);
+            trace.push_back({ slot, size_b });
+        }
+        return trace;
+    }
+
+    const std::vector<trace_op> &trace_() {
+        static const std::vector<trace_op> trace = trace_make_(200000, 8192);
+        return trace;
+    }
+
+    /**
+     * Replays the trace on a fresh allocator per iteration.
+     * Fragmentation is <b>1 - largest free block / free bytes</b> once the trace ends, heap_b is the mapped size.
+     */
+    template <typename A>
+    void BM_rbtalloc_fit(benchmark::State &state) {
+        const auto                   fit   = static_cast<ex::data::rbtalloc::fit_policy>(state.range(0));
+        const std::vector<trace_op> &trace = trace_();
+
+        double fragmentation = 0;
+        double heap_b        = 0;
+        for (auto _ : state) {
+            A                   allocator(1 MB, ex::data::mem_policy::standard(), fit);
+            std::vector<void *> slots(trace.size(), nullptr);
+
+            for (const trace_op &op : trace) {
+                if (op.size_b == 0) {
+                    allocator.free(slots[op.slot]);
+                    slots[op.slot] = nullptr;
+                } else {
+                    slots[op.slot] = allocator.malloc(op.size_b, 8);
+                }
+            }
+
+            state.PauseTiming();
+            u_int64_t free_b    = 0;
+            u_int64_t largest_b = 0;
+            for (auto &block : allocator.blocks_) {
+                if (!block.val.is_free)
+                    continue;
+                free_b   += block.val.size_b;
+                largest_b = std::max<u_int64_t>(largest_b, block.val.size_b);
+            }
+            fragmentation = free_b == 0 ? 0 : 1.0 - static_cast<double>(largest_b) / static_cast<double>(free_b);
+            heap_b        = static_cast<double>(allocator.memory_.size());
+            state.ResumeTiming();
+        }
+
+        state.counters["fragmentation"] = fragmentation;
+        state.counters["heap_b"]        = heap_b;
+        state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(trace.size()));
+    }
+}
+
+BENCHMARK(BM_rbtalloc_fit<ex::data::rbtalloc::allocator>)->ArgName("fit")->DenseRange(0, 2)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_rbtalloc_fit<ex::data::rbtalloc::compact_allocator>)->ArgName("fit")->DenseRange(0, 2)->Unit(benchmark::kMillisecond);
@@ -0,0 +1,44 @@
+//
+// Created by henryco on 17/10/26.
+//
+
+#include "../data/alloc/rbtalloc.h"
+#include <benchmark/benchmark.h>
+#include <random>
+#include <vector>
+
+namespace {
+
+    /**
+     * Keeps <b>live_n</b> mixed size blocks alive and churns malloc/free on random slots.
+     * Metadata is what the block index holds (tree node arena or flat node array) per block known to the allocator.
+     */
+    template <typename A>
+    void BM_rbtalloc_layout(benchmark::State &state) {
+        const int live_n = static_cast<int>(state.range(0));
+
+        A                   allocator;
+        std::mt19937        random(42);
+        std::vector<void *> live(live_n);
+        for (auto &ptr : live)
+            ptr = allocator.malloc(16 + random() % 512, 8);
+
+        for (auto _ : state) {
+            void *&ptr = live[random() % live_n];
+            allocator.free(ptr);
+            ptr = allocator.malloc(16 + random() % 512, 8);
+        }
+
+        const double meta_b = static_cast<double>(allocator.meta_used_());
+        state.counters["meta_b_per_block"] = meta_b / static_cast<double>(allocator.blocks_total());
+        state.counters["node_b"]           = sizeof(typename A::rmq_node);
+        state.counters["nodes_per_line"]   = 64.0 / static_cast<double>(sizeof(typename A::rmq_node));
+        state.SetItemsProcessed(state.iterations() * 2);
+
+        for (void *ptr : live)
+            allocator.free(ptr);
+    }
+}
+
+BENCHMARK(BM_rbtalloc_layout<ex::data::rbtalloc::allocator>)->Arg(1024)->Arg(16384)->Arg(131072);
+BENCHMARK(BM_rbtalloc_layout<ex::data::rbtalloc::compact_allocator>)->Arg(1024)->Arg(16384)->Arg(131072);
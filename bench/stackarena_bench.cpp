@@ -0,0 +1,86 @@
+//
+// Created by henryco on 17/10/26.
+//
+
+#include "../data/alloc/stackarena.h"
+#include <benchmark/benchmark.h>
+#include <mutex>
+
+namespace {
+
+    constexpr int BLOCK_S   = 48;
+    constexpr int OBJECTS_N = 512;
+
+    struct locked_stackarena {
+        ex::data::stackarena::allocator allocator_{ BLOCK_S, 1 MB };
+        std::mutex                      lock_;
+
+        void *malloc(const std::size_t size_b, const std::size_t alignment_b) {
+            std::lock_guard guard(lock_);
+            return allocator_.malloc(size_b, alignment_b);
+        }
+
+        void free(void *ptr) {
+            std::lock_guard guard(lock_);
+            allocator_.free(ptr);
+        }
+    };
+
+    ex::data::stackarena::concurrent_allocator concurrent_{ BLOCK_S, 1 MB };
+    locked_stackarena                          locked_;
+
+    /**
+     * Every block is stamped with its owner and checked before release,
+     * a block handed out twice (lost ABA race) shows up as a foreign stamp.
+     * Half of the blocks are released by the neighbour thread.
+     */
+    template <typename A>
+    void stress_(benchmark::State &state, A &allocator) {
+        static u_int64_t *slots_[64][OBJECTS_N];
+        static std::mutex slot_lock_[64];
+
+        const int       self  = state.thread_index();
+        const int       peer  = (self + 1) % state.threads();
+        const u_int64_t stamp = 0x5a5a000000000000ULL | static_cast<u_int64_t>(self);
+
+        for (auto _ : state) {
+            {
+                std::lock_guard guard(slot_lock_[self]);
+                for (int i = 0; i < OBJECTS_N; ++i) {
+                    if (slots_[self][i] != nullptr)
+                        allocator.free(slots_[self][i]);
+                    auto *block = static_cast<u_int64_t *>(allocator.malloc(BLOCK_S, 8));
+                    for (int k = 0; k < BLOCK_S / 8; ++k)
+                        block[k] = stamp;
+                    slots_[self][i] = block;
+                }
+                for (int i = 0; i < OBJECTS_N; ++i) {
+                    for (int k = 0; k < BLOCK_S / 8; ++k) {
+                        if (slots_[self][i][k] != stamp)
+                            abort_("block shared between owners: " << slots_[self][i]);
+                    }
+                }
+            }
+            {
+                std::lock_guard guard(slot_lock_[peer]);
+                for (int i = 0; i < OBJECTS_N; i += 2) {
+                    if (slots_[peer][i] != nullptr)
+                        allocator.free(slots_[peer][i]);
+                    slots_[peer][i] = nullptr;
+                }
+            }
+        }
+        state.SetItemsProcessed(state.iterations() * OBJECTS_N);
+    }
+
+    void BM_stackarena_concurrent(benchmark::State &state) {
+        stress_(state, concurrent_);
+    }
+
+    void BM_stackarena_mutex(benchmark::State &state) {
+        stress_(state, locked_);
+    }
+}
+
+BENCHMARK(BM_stackarena_concurrent)->ThreadRange(1, 8)->UseRealTime();
+BENCHMARK(BM_stackarena_mutex)->ThreadRange(1, 8)->UseRealTime();
@@ -0,0 +1,426 @@
+//
+// Created by henryco on 17/10/26.
+//
+
+#include "../data/struct/array.h"
+#include "../data/struct/array_map.h"
+#include "../data/struct/buffer.h"
+#include "../data/struct/cache.h"
+#include "../data/struct/flat_rmq_map.h"
+#include "../data/struct/lifo_queue.h"
+#include "../data/struct/list_map.h"
+#include "../data/struct/rb_map.h"
+#include "../data/struct/rmq_map.h"
+#include "../data/struct/sorted_map.h"
+#include <benchmark/benchmark.h>
+#include <algorithm>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+    /**
+     * 0..n-1 in random order, same for every run
+     */
+    std::vector<int> keys_(const int n) {
+        std::vector<int> keys(n);
+        for (int i = 0; i < n; ++i)
+            keys[i] = i;
+        std::shuffle(keys.begin(), keys.end(), std::mt19937(42));
+        return keys;
+    }
+
+    template <typename A>
+    void BM_array_push(benchmark::State &state) {
+        const int n = static_cast<int>(state.range(0));
+        for (auto _ : state) {
+            A array;
+            for (int i = 0; i < n; ++i)
+                array.emplace_back(i);
+            benchmark::DoNotOptimize(&array);
+        }
+        state.SetItemsProcessed(state.iterations() * n);
+    }
+
+    /**
+     * Non-trivial values: moved on growth, destroyed with the array
+     */
+    template <typename A>
+    void BM_array_push_string(benchmark::State &state) {
+        const int         n = static_cast<int>(state.range(0));
+        const std::string value(32, 'x');
+        for (auto _ : state) {
+            A array;
+            for (int i = 0; i < n; ++i)
+                array.emplace_back(value);
+            benchmark::DoNotOptimize(&array);
+        }
+        state.SetItemsProcessed(state.iterations() * n);
+    }
+
+    void BM_array_iterate(benchmark::State &state) {
+        const int            n = static_cast<int>(state.range(0));
+        ex::data::array<int> array;
+        for (int i = 0; i < n; ++i)
+            array.push(i);
+
+        for (auto _ : state) {
+            long sum = 0;
+            for (const int value : array)
+                sum += value;
+            benchmark::DoNotOptimize(sum);
+        }
+        state.SetItemsProcessed(state.iterations() * n);
+    }
+
+    void BM_buffer_grow(benchmark::State &state) {
+        const int n = static_cast<int>(state.range(0));
+        for (auto _ : state) {
+            ex::data::buffer<char> buffer;
+            for (int size = 64; size <= n; size *= 2)
+                buffer.allocate(size);
+            benchmark::DoNotOptimize(buffer.data);
+        }
+    }
+
+    template <typename K>
+    void BM_array_map_lookup(benchmark::State &state) {
+        const int                   n    = static_cast<int>(state.range(0));
+        const std::vector<int>      keys = keys_(n);
+        ex::data::array_map<K, int> map;
+        for (const int key : keys)
+            map.put(static_cast<K>(key), key);
+
+        for (auto _ : state)
+            for (const int key : keys)
+                benchmark::DoNotOptimize(map.at(static_cast<K>(key)));
+        state.SetItemsProcessed(state.iterations() * n);
+    }
+
+    /**
+     * Graph node shaped load: many small port tables created, filled and dropped
+     */
+    template <typename M>
+    void BM_small_map_fill(benchmark::State &state) {
+        constexpr int maps_n = 1024;
+        const int     n      = static_cast<int>(state.range(0));
+        for (auto _ : state) {
+            std::vector<M> maps;
+            maps.reserve(maps_n);
+            for (int i = 0; i < maps_n; ++i) {
+                M &map = maps.emplace_back(8);
+                for (int k = 0; k < n; ++k)
+                    map.put(static_cast<u_int16_t>(k), nullptr);
+            }
+            benchmark::DoNotOptimize(maps.data());
+        }
+        state.SetItemsProcessed(state.iterations() * maps_n);
+    }
+
+    void BM_sorted_map_put(benchmark::State &state) {
+        const int              n    = static_cast<int>(state.range(0));
+        const std::vector<int> keys = keys_(n);
+        for (auto _ : state) {
+            ex::data::sorted_map<int, int> map;
+            for (const int key : keys)
+                map.put(key, key);
+            benchmark::DoNotOptimize(map.at(keys[0]));
+        }
+        state.SetItemsProcessed(state.iterations() * n);
+    }
+
+    void BM_sorted_map_lookup(benchmark::State &state) {
+        const int                      n    = static_cast<int>(state.range(0));
+        const std::vector<int>         keys = keys_(n);
+        ex::data::sorted_map<int, int> map;
+        for (const int key : keys)
+            map.put(key, key);
+
+        for (auto _ : state)
+            for (const int key : keys)
+                benchmark::DoNotOptimize(map.at(key));
+        state.SetItemsProcessed(state.iterations() * n);
+    }
+
+    template <typename M>
+    void BM_rb_map_put(benchmark::State &state) {
+        const int              n    = static_cast<int>(state.range(0));
+        const std::vector<int> keys = keys_(n);
+        for (auto _ : state) {
+            M map;
+            for (const int key : keys)
+                map.put(key, key);
+            benchmark::DoNotOptimize(map.size());
+        }
+        state.SetItemsProcessed(state.iterations() * n);
+    }
+
+    void BM_rb_map_lookup(benchmark::State &state) {
+        const int                  n    = static_cast<int>(state.range(0));
+        const std::vector<int>     keys = keys_(n);
+        ex::data::rb_map<int, int> map;
+        for (const int key : keys)
+            map.put(key, key);
+
+        for (auto _ : state)
+            for (const int key : keys)
+                benchmark::DoNotOptimize(map.at(key));
+        state.SetItemsProcessed(state.iterations() * n);
+    }
+
+    /**
+     * Ascending keys, n puts against one bulk build
+     */
+    template <typename M, bool bulk>
+    void BM_map_from_sorted(benchmark::State &state) {
+        const int                          n = static_cast<int>(state.range(0));
+        std::vector<typename M::entry>     entries(n);
+        for (int i = 0; i < n; ++i) {
+            entries[i].key = i;
+            entries[i].val = i;
+        }
+
+        for (auto _ : state) {
+            M map;
+            if (bulk) map.build_sorted(entries.data(), n);
+            else      for (const auto &entry : entries) map.put(entry);
+            benchmark::DoNotOptimize(map.root_);
+        }
+        state.SetItemsProcessed(state.iterations() * n);
+    }
+
+    /**
+     * Percentile style queries: rank of a random key, then the element at a random rank
+     */
+    void BM_rb_map_rank_select(benchmark::State &state) {
+        const int                        n    = static_cast<int>(state.range(0));
+        const std::vector<int>           keys = keys_(n);
+        ex::data::rb_map<int, int, true> map;
+        for (const int key : keys)
+            map.put(key, key);
+
+        for (auto _ : state)
+            for (const int key : keys) {
+                benchmark::DoNotOptimize(map.rank(key));
+                benchmark::DoNotOptimize(map.select(key));
+            }
+        state.SetItemsProcessed(state.iterations() * n * 2);
+    }
+
+    void BM_rb_map_iterate(benchmark::State &state) {
+        const int                  n    = static_cast<int>(state.range(0));
+        ex::data::rb_map<int, int> map;
+        for (const int key : keys_(n))
+            map.put(key, key);
+
+        for (auto _ : state) {
+            long sum = 0;
+            for (const auto &entry : map)
+                sum += entry.val;
+            benchmark::DoNotOptimize(sum);
+        }
+        state.SetItemsProcessed(state.iterations() * n);
+    }
+
+    /**
+     * Every key carries a random range value, queries ask for the first node at or above a random bound
+     */
+    template <typename M>
+    void BM_rmq_range_fit(benchmark::State &state) {
+        const int        n      = static_cast<int>(state.range(0));
+        std::mt19937     random(42);
+        M                map;
+        for (const int key : keys_(n))
+            map.put(key, key, random() % 65536);
+
+        std::vector<int> bounds(1024);
+        for (int &bound : bounds)
+            bound = random() % 65536;
+
+        for (auto _ : state)
+            for (const int bound : bounds)
+                benchmark::DoNotOptimize(map.range_fit(bound, 65536));
+        state.SetItemsProcessed(state.iterations() * bounds.size());
+    }
+
+    /**
+     * Windowed sums over time-like keys, window a sixteenth of the map
+     */
+    void BM_rmq_aggregate(benchmark::State &state) {
+        using map_t = ex::data::rmq_map<int, int, int, ex::data::rmq_sum_agg<int64_t>>;
+
+        const int    n = static_cast<int>(state.range(0));
+        std::mt19937 random(42);
+        map_t        map;
+        for (const int key : keys_(n))
+            map.put(key, key, random() % 65536);
+
+        std::vector<int> starts(1024);
+        for (int &start : starts)
+            start = random() % n;
+
+        for (auto _ : state)
+            for (const int start : starts)
+                benchmark::DoNotOptimize(map.aggregate(start, start + n / 16));
+        state.SetItemsProcessed(state.iterations() * starts.size());
+    }
+
+    /**
+     * Time-like intervals (start key, end range value a little later), every end inside a narrow window:
+     * pruned walk against a full in-order scan
+     */
+    template <bool pruned>
+    void BM_rmq_overlap(benchmark::State &state) {
+        const int                              n = static_cast<int>(state.range(0));
+        std::mt19937                           random(42);
+        ex::data::rmq_map<int, int, int>       map;
+        for (const int key : keys_(n))
+            map.put(key, key, key + random() % 64);
+
+        std::vector<int> bounds(256);
+        for (int &bound : bounds)
+            bound = random() % n;
+
+        for (auto _ : state)
+            for (const int bound : bounds) {
+                long sum = 0;
+                if (pruned) {
+                    map.for_each_overlap(bound, bound + 15, [&sum](auto *node) { sum += node->key; });
+                }
+                else {
+                    for (const auto &node : map)
+                        if (node.rmq >= bound && node.rmq <= bound + 15)
+                            sum += node.key;
+                }
+                benchmark::DoNotOptimize(sum);
+            }
+        state.SetItemsProcessed(state.iterations() * bounds.size());
+    }
+
+    void BM_list_map_put(benchmark::State &state) {
+        const int              n    = static_cast<int>(state.range(0));
+        const std::vector<int> keys = keys_(n);
+        for (auto _ : state) {
+            ex::data::list_map<int, int> map;
+            for (const int key : keys)
+                map.put_back(key, key);
+            benchmark::DoNotOptimize(map.size());
+        }
+        state.SetItemsProcessed(state.iterations() * n);
+    }
+
+    void BM_list_map_lookup(benchmark::State &state) {
+        const int                    n    = static_cast<int>(state.range(0));
+        const std::vector<int>       keys = keys_(n);
+        ex::data::list_map<int, int> map;
+        for (const int key : keys)
+            map.put_back(key, key);
+
+        for (auto _ : state)
+            for (const int key : keys)
+                benchmark::DoNotOptimize(map.at(key));
+        state.SetItemsProcessed(state.iterations() * n);
+    }
+
+    /**
+     * threads_n 0 is the in-list merge sort, 1 the gathered one, more the parallel one.
+     * Keys are reshuffled (untimed) before every sort
+     */
+    template <int threads_n>
+    void BM_list_map_sort(benchmark::State &state) {
+        const int                    n    = static_cast<int>(state.range(0));
+        const std::vector<int>       keys = keys_(n);
+        ex::data::list_map<int, int> map;
+        for (const int key : keys)
+            map.put_back(key, key);
+
+        for (auto _ : state) {
+            state.PauseTiming();
+            int i = 0;
+            for (auto *node = map.root_; node != nullptr; node = node->next)
+                node->key = keys[i++];
+            state.ResumeTiming();
+
+            if constexpr (threads_n == 0) map.sort();
+            else                          map.sort_parallel(threads_n);
+            benchmark::DoNotOptimize(map.root_);
+        }
+        state.SetItemsProcessed(state.iterations() * n);
+    }
+
+    void BM_lifo_queue_push_pop(benchmark::State &state) {
+        const int                 n = static_cast<int>(state.range(0));
+        ex::data::lifo_queue<int> queue;
+        for (auto _ : state) {
+            for (int i = 0; i < n; ++i)
+                queue.push(i);
+            long sum = 0;
+            while (!queue.empty())
+                sum += queue.pop();
+            benchmark::DoNotOptimize(sum);
+        }
+        state.SetItemsProcessed(state.iterations() * n * 2);
+    }
+
+    int cache_supplier_(const int &key) {
+        return key * 31 + 7;
+    }
+
+    /**
+     * Replays the same id sequence every pass, as the cache line expects
+     */
+    void BM_cache_line_replay(benchmark::State &state) {
+        const int                         n    = static_cast<int>(state.range(0));
+        const std::vector<int>            keys = keys_(n);
+        ex::data::cache_line<int, int>    cache(&cache_supplier_, n);
+        cache.begin();
+        for (const int key : keys)
+            cache(key);
+        cache.end();
+
+        for (auto _ : state) {
+            cache.begin();
+            for (const int key : keys)
+                benchmark::DoNotOptimize(cache(key));
+            cache.end();
+        }
+        state.SetItemsProcessed(state.iterations() * n);
+    }
+}
+
+BENCHMARK(BM_array_push<ex::data::array<int>>)->Arg(8)->Arg(64)->Arg(1024)->Arg(16384);
+BENCHMARK(BM_array_push<ex::data::array<int, 16>>)->Arg(8)->Arg(64);
+BENCHMARK(BM_array_push<std::vector<int>>)->Arg(8)->Arg(64)->Arg(1024)->Arg(16384);
+BENCHMARK(BM_array_push_string<ex::data::array<std::string>>)->Arg(64)->Arg(1024);
+BENCHMARK(BM_array_push_string<std::vector<std::string>>)->Arg(64)->Arg(1024);
+BENCHMARK(BM_array_iterate)->Arg(64)->Arg(1024)->Arg(16384);
+BENCHMARK(BM_buffer_grow)->Arg(4096)->Arg(1 << 20);
+BENCHMARK(BM_array_map_lookup<int>)->Arg(16)->Arg(64)->Arg(256);
+BENCHMARK(BM_array_map_lookup<u_int16_t>)->Arg(16)->Arg(64)->Arg(256);
+BENCHMARK(BM_array_map_lookup<u_int64_t>)->Arg(16)->Arg(64)->Arg(256);
+BENCHMARK(BM_small_map_fill<ex::data::array_map<u_int16_t, void *>>)->Arg(4)->Arg(16);
+BENCHMARK(BM_small_map_fill<ex::data::inline_array_map<u_int16_t, void *, 8>>)->Arg(4)->Arg(16);
+BENCHMARK(BM_sorted_map_put)->Arg(64)->Arg(1024)->Arg(16384);
+BENCHMARK(BM_sorted_map_lookup)->Arg(64)->Arg(1024)->Arg(16384);
+BENCHMARK(BM_rb_map_put<ex::data::rb_map<int, int>>)->Arg(64)->Arg(1024)->Arg(16384);
+BENCHMARK(BM_rb_map_put<ex::data::rb_map<int, int, true>>)->Arg(64)->Arg(1024)->Arg(16384);
+BENCHMARK(BM_rb_map_lookup)->Arg(64)->Arg(1024)->Arg(16384);
+BENCHMARK(BM_map_from_sorted<ex::data::rb_map<int, int>, false>)->Arg(1024)->Arg(1 << 20);
+BENCHMARK(BM_map_from_sorted<ex::data::rb_map<int, int>, true>)->Arg(1024)->Arg(1 << 20);
+BENCHMARK(BM_map_from_sorted<ex::data::rmq_map<int, int, int>, false>)->Arg(1024)->Arg(1 << 20);
+BENCHMARK(BM_map_from_sorted<ex::data::rmq_map<int, int, int>, true>)->Arg(1024)->Arg(1 << 20);
+BENCHMARK(BM_rb_map_rank_select)->Arg(1024)->Arg(16384);
+BENCHMARK(BM_rb_map_iterate)->Arg(64)->Arg(1024)->Arg(16384);
+BENCHMARK(BM_rmq_range_fit<ex::data::rmq_map<int, int, int>>)->Arg(1024)->Arg(16384);
+BENCHMARK(BM_rmq_range_fit<ex::data::flat_rmq_map<int, int, int>>)->Arg(1024)->Arg(16384);
+BENCHMARK(BM_rmq_aggregate)->Arg(1024)->Arg(1 << 20);
+BENCHMARK(BM_rmq_overlap<false>)->Arg(1024)->Arg(65536);
+BENCHMARK(BM_rmq_overlap<true>)->Arg(1024)->Arg(65536);
+BENCHMARK(BM_list_map_put)->Arg(64)->Arg(1024);
+BENCHMARK(BM_list_map_lookup)->Arg(64)->Arg(1024);
+BENCHMARK(BM_list_map_sort<0>)->Arg(1 << 16)->Arg(1 << 20)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_list_map_sort<1>)->Arg(1 << 16)->Arg(1 << 20)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_list_map_sort<4>)->Arg(1 << 16)->Arg(1 << 20)->Unit(benchmark::kMillisecond)->UseRealTime();
+BENCHMARK(BM_lifo_queue_push_pop)->Arg(64)->Arg(1024)->Arg(16384);
+BENCHMARK(BM_cache_line_replay)->Arg(64)->Arg(1024);
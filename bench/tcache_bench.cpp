@@ -0,0 +1,120 @@
+//
+// Created by henryco on 17/10/26.
+//
+
+#include "../data/alloc/tcache.h"
+#include <benchmark/benchmark.h>
+#include <mutex>
+
+namespace {
+
+    constexpr int OBJECTS_N = 256;
+
+    struct locked_lalloc {
+        ex::data::lalloc::allocator allocator_;
+        std::mutex                  lock_;
+
+        void *malloc(const std::size_t size_b, const std::size_t alignment_b) {
+            std::lock_guard guard(lock_);
+            return allocator_.malloc(size_b, alignment_b);
+        }
+
+        void free(void *ptr) {
+            std::lock_guard guard(lock_);
+            allocator_.free(ptr);
+        }
+    };
+
+    struct glibc_malloc {
+        void *malloc(const std::size_t size_b, std::size_t) {
+            return ::malloc(size_b);
+        }
+
+        void free(void *ptr) {
+            ::free(ptr);
+        }
+    };
+
+    ex::data::tcache::allocator tcache_;
+    locked_lalloc               locked_;
+    glibc_malloc                glibc_;
+
+    std::size_t object_size_(const int i) {
+        return 16 + ((i * 37) % 16) * 24;
+    }
+
+    template <typename A>
+    void churn_(benchmark::State &state, A &allocator) {
+        void *objects[OBJECTS_N];
+        for (auto _ : state) {
+            for (int i = 0; i < OBJECTS_N; ++i)
+                objects[i] = allocator.malloc(object_size_(i), 8);
+            benchmark::DoNotOptimize(objects);
+            for (int i = OBJECTS_N - 1; i >= 0; --i)
+                allocator.free(objects[i]);
+        }
+        state.SetItemsProcessed(state.iterations() * OBJECTS_N);
+    }
+
+    void BM_tcache_churn(benchmark::State &state) {
+        churn_(state, tcache_);
+    }
+
+    void BM_lalloc_mutex_churn(benchmark::State &state) {
+        churn_(state, locked_);
+    }
+
+    void BM_glibc_churn(benchmark::State &state) {
+        churn_(state, glibc_);
+    }
+
+    /**
+     * Objects allocated by one thread and freed by its neighbour
+     */
+    template <typename A>
+    void cross_free_(benchmark::State &state, A &allocator) {
+        static void *slots_[64][OBJECTS_N];
+        static std::mutex slot_lock_[64];
+
+        const int self = state.thread_index();
+        const int peer = (self + 1) % state.threads();
+
+        for (auto _ : state) {
+            {
+                std::lock_guard guard(slot_lock_[self]);
+                for (int i = 0; i < OBJECTS_N; ++i) {
+                    allocator.free(slots_[self][i]); // leftovers peer did not pick up yet
+                    slots_[self][i] = allocator.malloc(object_size_(i), 8);
+                }
+            }
+            {
+                std::lock_guard guard(slot_lock_[peer]);
+                for (int i = 0; i < OBJECTS_N; ++i) {
+                    allocator.free(slots_[peer][i]);
+                    slots_[peer][i] = nullptr;
+                }
+            }
+        }
+        state.SetItemsProcessed(state.iterations() * OBJECTS_N);
+    }
+
+    void BM_tcache_cross_free(benchmark::State &state) {
+        cross_free_(state, tcache_);
+    }
+
+    void BM_lalloc_mutex_cross_free(benchmark::State &state) {
+        cross_free_(state, locked_);
+    }
+
+    void BM_glibc_cross_free(benchmark::State &state) {
+        cross_free_(state, glibc_);
+    }
+}
+
+BENCHMARK(BM_tcache_churn)->ThreadRange(1, 8)->UseRealTime();
+BENCHMARK(BM_lalloc_mutex_churn)->ThreadRange(1, 8)->UseRealTime();
+BENCHMARK(BM_glibc_churn)->ThreadRange(1, 8)->UseRealTime();
+
+BENCHMARK(BM_tcache_cross_free)->ThreadRange(1, 8)->UseRealTime();
+BENCHMARK(BM_lalloc_mutex_cross_free)->ThreadRange(1, 8)->UseRealTime();
+BENCHMARK(BM_glibc_cross_free)->ThreadRange(1, 8)->UseRealTime();
@@ -70,8 +70,8 @@ namespace limbo::bytebox {
 
     namespace internal_ {
         struct element {
-            header      header;
-            const void *data;
+            bytebox::header header;
+            const void     *data;
         };
     }
 
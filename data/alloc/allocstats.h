@@ -0,0 +1,135 @@
+//
+// Created by henryco on 17/10/26.
+//
+
+#ifndef EX_LIMBO_DATA_ALLOCSTATS_H
+#define EX_LIMBO_DATA_ALLOCSTATS_H
+
+#include <atomic>
+#include <cstdint>
+#include <sys/types.h>
+
+// Allocation statistics are compiled in only with ALLOC_STATS defined,
+// otherwise every alloc_stats_(...) hook expands to nothing.
+#ifdef ALLOC_STATS
+    #define alloc_stats_(expr) expr
+#else
+    #define alloc_stats_(expr)
+#endif
+
+#define STATS_CLASS_NUM (32) // power of two size classes, [2^i, 2^(i+1))
+
+namespace ex::data {
+
+    struct alloc_stats_snapshot {
+        u_int64_t malloc_n[STATS_CLASS_NUM];
+        u_int64_t free_n[STATS_CLASS_NUM];
+        u_int64_t free_blocks[STATS_CLASS_NUM]; // free block size histogram
+        u_int64_t realloc_n;
+        u_int64_t live_b;
+        u_int64_t peak_b;
+        u_int64_t free_b;                       // bytes held by free blocks
+        u_int64_t free_largest_b;
+        double    fragmentation;                // 1 - largest free block / free bytes
+    };
+
+    /**
+     * Allocator counters. Writers are the allocator itself (under whatever lock it needs),
+     * readers may scrape snapshot() from any thread at any time, every counter is a relaxed atomic,
+     * so a snapshot is consistent per counter, not across counters.
+     */
+    struct alloc_stats {
+
+        std::atomic<u_int64_t> malloc_n[STATS_CLASS_NUM]    = {};
+        std::atomic<u_int64_t> free_n[STATS_CLASS_NUM]      = {};
+        std::atomic<u_int64_t> free_blocks[STATS_CLASS_NUM] = {};
+
+        std::atomic<u_int64_t> realloc_n      = 0;
+        std::atomic<u_int64_t> live_b         = 0;
+        std::atomic<u_int64_t> peak_b         = 0;
+        std::atomic<u_int64_t> free_b         = 0;
+        std::atomic<u_int64_t> free_largest_b = 0;
+
+        void on_malloc(const u_int64_t size_b) {
+            malloc_n[class_of(size_b)].fetch_add(1, std::memory_order_relaxed);
+            live_add_(size_b);
+        }
+
+        void on_free(const u_int64_t size_b) {
+            free_n[class_of(size_b)].fetch_add(1, std::memory_order_relaxed);
+            live_b.fetch_sub(size_b, std::memory_order_relaxed);
+        }
+
+        void on_realloc(const u_int64_t size_old_b, const u_int64_t size_new_b) {
+            realloc_n.fetch_add(1, std::memory_order_relaxed);
+            free_n[class_of(size_old_b)].fetch_add(1, std::memory_order_relaxed);
+            malloc_n[class_of(size_new_b)].fetch_add(1, std::memory_order_relaxed);
+            live_b.fetch_sub(size_old_b, std::memory_order_relaxed);
+            live_add_(size_new_b);
+        }
+
+        void on_block_free(const u_int64_t size_b) {
+            free_blocks[class_of(size_b)].fetch_add(1, std::memory_order_relaxed);
+            free_b.fetch_add(size_b, std::memory_order_relaxed);
+        }
+
+        void on_block_taken(const u_int64_t size_b) {
+            free_blocks[class_of(size_b)].fetch_sub(1, std::memory_order_relaxed);
+            free_b.fetch_sub(size_b, std::memory_order_relaxed);
+        }
+
+        void on_largest(const u_int64_t size_b) {
+            free_largest_b.store(size_b, std::memory_order_relaxed);
+        }
+
+        u_int64_t largest() const {
+            return free_largest_b.load(std::memory_order_relaxed);
+        }
+
+        void snapshot(alloc_stats_snapshot *out) const {
+            for (int i = 0; i < STATS_CLASS_NUM; ++i) {
+                out->malloc_n[i]    = malloc_n[i].load(std::memory_order_relaxed);
+                out->free_n[i]      = free_n[i].load(std::memory_order_relaxed);
+                out->free_blocks[i] = free_blocks[i].load(std::memory_order_relaxed);
+            }
+            out->realloc_n      = realloc_n.load(std::memory_order_relaxed);
+            out->live_b         = live_b.load(std::memory_order_relaxed);
+            out->peak_b         = peak_b.load(std::memory_order_relaxed);
+            out->free_b         = free_b.load(std::memory_order_relaxed);
+            out->free_largest_b = free_largest_b.load(std::memory_order_relaxed);
+            out->fragmentation  = out->free_b == 0
+                ? 0.0
+                : 1.0 - static_cast<double>(out->free_largest_b) / static_cast<double>(out->free_b);
+        }
+
+        void reset() {
+            for (int i = 0; i < STATS_CLASS_NUM; ++i) {
+                malloc_n[i].store(0, std::memory_order_relaxed);
+                free_n[i].store(0, std::memory_order_relaxed);
+                free_blocks[i].store(0, std::memory_order_relaxed);
+            }
+            realloc_n.store(0, std::memory_order_relaxed);
+            live_b.store(0, std::memory_order_relaxed);
+            peak_b.store(0, std::memory_order_relaxed);
+            free_b.store(0, std::memory_order_relaxed);
+            free_largest_b.store(0, std::memory_order_relaxed);
+        }
+
+        static u_int32_t class_of(const u_int64_t size_b) {
+            if (size_b == 0)
+                return 0;
+            const u_int32_t power = 63 - __builtin_clzll(size_b);
+            return power < STATS_CLASS_NUM ? power : STATS_CLASS_NUM - 1;
+        }
+
+        void live_add_(const u_int64_t size_b) {
+            const u_int64_t live = live_b.fetch_add(size_b, std::memory_order_relaxed) + size_b;
+            u_int64_t       peak = peak_b.load(std::memory_order_relaxed);
+            while (live > peak && !peak_b.compare_exchange_weak(peak, live, std::memory_order_relaxed))
+                ;
+        }
+    };
+
+}
+
+#endif //EX_LIMBO_DATA_ALLOCSTATS_H
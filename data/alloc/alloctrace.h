@@ -0,0 +1,245 @@
+//
+// Created by henryco on 17/10/26.
+//
+
+#ifndef EX_LIMBO_DATA_ALLOCTRACE_H
+#define EX_LIMBO_DATA_ALLOCTRACE_H
+
+#include "datalloc.h"
+#include <chrono>
+#include <cstdio>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace ex::data::alloctrace {
+
+#define TRACE_MAGIC   (0x4352544CU) // "LTRC"
+#define TRACE_VERSION (1U)
+#define TRACE_FLUSH_N (4096)        // records buffered before a write
+
+    enum class trace_op : u_int8_t {
+        malloc,
+        realloc,
+        free,
+    };
+
+    struct trace_header {
+        u_int32_t magic;
+        u_int32_t version;
+    };
+
+    /**
+     * Objects are numbered in malloc order and keep their id across reallocs,
+     * so a trace replays without the addresses it was recorded with
+     */
+    struct trace_record {
+        u_int64_t time_ns;     // since the recorder was opened
+        u_int32_t id;
+        u_int32_t size_b;      // new size for realloc, 0 for free
+        u_int32_t alignment_b;
+        trace_op  op;
+        u_int8_t  pad_[3];
+    };
+
+    static_assert(sizeof(trace_record) == 24);
+
+    /**
+     * Wraps any <b>ex::data::allocator</b> and appends every malloc/realloc/free going through compat() to a binary file.
+     * Batch calls are recorded per object, free_sized as free, a successful try_expand as realloc.
+     * Every call runs under one mutex (the wrapped allocator included), the records are in the order the wrapped allocator saw them.
+     */
+    struct recorder {
+
+        ex::data::allocator inner_;
+
+        std::FILE                            *file_ = nullptr;
+        std::mutex                            lock_;
+        std::unordered_map<void *, u_int32_t> ids_;
+        u_int32_t                             next_id_ = 0;
+
+        trace_record buffer_[TRACE_FLUSH_N];
+        std::size_t  buffer_n_ = 0;
+
+        const std::chrono::steady_clock::time_point start_ = std::chrono::steady_clock::now();
+
+        recorder(const ex::data::allocator &inner, const char *path) :
+            inner_(inner) {
+            file_ = std::fopen(path, "wb");
+            if (file_ == nullptr)
+                abort_("Cannot open trace file");
+            const trace_header header = { TRACE_MAGIC, TRACE_VERSION };
+            if (std::fwrite(&header, sizeof(header), 1, file_) != 1)
+                abort_("Cannot write trace header");
+        }
+
+        recorder(const recorder &other) = delete;
+        recorder(recorder &&other)      = delete;
+
+        recorder &operator = (const recorder &other) = delete;
+        recorder &operator = (recorder &&other)      = delete;
+
+        ~recorder() {
+            close();
+        }
+
+        ex::data::allocator compat() {
+            return { .malloc     = &recorder::malloc_,
+                     .realloc    = &recorder::realloc_,
+                     .free       = &recorder::free_,
+                     .free_sized = &recorder::free_sized_,
+                     .try_expand = &recorder::try_expand_,
+                     .size_total = &recorder::size_total_,
+                     .size_used  = &recorder::size_used_,
+                     .instance   = this };
+        }
+
+        void flush() {
+            std::lock_guard guard(lock_);
+            flush_();
+        }
+
+        void close() {
+            std::lock_guard guard(lock_);
+            if (file_ == nullptr)
+                return;
+            flush_();
+            std::fclose(file_);
+            file_ = nullptr;
+        }
+
+        // =========================================== INTERNAL UTILS ==================================================
+
+        static recorder *of_(void *this_) {
+            return static_cast<recorder *>(static_cast<const ex::data::allocator *>(this_)->instance);
+        }
+
+        static void *malloc_(void *this_, const std::size_t size_new_b, const std::size_t alignment_b) {
+            recorder       *self = of_(this_);
+            std::lock_guard guard(self->lock_);
+            void           *ptr  = self->inner_.malloc(&self->inner_, size_new_b, alignment_b);
+
+            const u_int32_t id = self->next_id_++;
+            self->ids_[ptr] = id;
+            self->record_(trace_op::malloc, id, size_new_b, alignment_b);
+            return ptr;
+        }
+
+        static void *realloc_(void *this_, void *ptr, const std::size_t size_new_b) {
+            if (ptr == nullptr)
+                return malloc_(this_, size_new_b, alignof(std::max_align_t));
+            recorder       *self = of_(this_);
+            std::lock_guard guard(self->lock_);
+
+            // id taken first, once the inner realloc returns the old address may go to another thread
+            const u_int32_t id = self->id_of_(ptr);
+            self->ids_.erase(ptr);
+
+            void *allocated = self->inner_.realloc(&self->inner_, ptr, size_new_b);
+            if (allocated == nullptr) {
+                if (size_new_b == 0)
+                    self->record_(trace_op::free, id, 0, 0);
+                else
+                    self->ids_[ptr] = id; // failed, the old block is still live
+                return nullptr;
+            }
+            self->ids_[allocated] = id;
+            self->record_(trace_op::realloc, id, size_new_b, 0);
+            return allocated;
+        }
+
+        static void free_(void *this_, void *ptr) {
+            if (ptr == nullptr)
+                return;
+            recorder       *self = of_(this_);
+            std::lock_guard guard(self->lock_);
+            self->record_(trace_op::free, self->id_of_(ptr), 0, 0);
+            self->ids_.erase(ptr);
+            if (self->inner_.free != nullptr)
+                self->inner_.free(&self->inner_, ptr);
+        }
+
+        static void free_sized_(void *this_, void *ptr, const std::size_t size_b, const std::size_t alignment_b) {
+            if (ptr == nullptr)
+                return;
+            recorder       *self = of_(this_);
+            std::lock_guard guard(self->lock_);
+            self->record_(trace_op::free, self->id_of_(ptr), 0, 0);
+            self->ids_.erase(ptr);
+            if (self->inner_.free_sized != nullptr)
+                self->inner_.free_sized(&self->inner_, ptr, size_b, alignment_b);
+            else if (self->inner_.free != nullptr)
+                self->inner_.free(&self->inner_, ptr);
+        }
+
+        static bool try_expand_(void *this_, void *ptr, const std::size_t size_new_b) {
+            recorder       *self = of_(this_);
+            std::lock_guard guard(self->lock_);
+            if (self->inner_.try_expand == nullptr || !self->inner_.try_expand(&self->inner_, ptr, size_new_b))
+                return false;
+
+            self->record_(trace_op::realloc, self->id_of_(ptr), size_new_b, 0);
+            return true;
+        }
+
+        static long size_total_(void *this_) {
+            recorder *self = of_(this_);
+            return self->inner_.size_total(&self->inner_);
+        }
+
+        static long size_used_(void *this_) {
+            recorder *self = of_(this_);
+            return self->inner_.size_used(&self->inner_);
+        }
+
+        /**
+         * Pointers the recorder has not seen (allocated before wrapping) get a fresh id
+         */
+        u_int32_t id_of_(void *ptr) {
+            const auto found = ids_.find(ptr);
+            return found != ids_.end() ? found->second : next_id_++;
+        }
+
+        void record_(const trace_op op, const u_int32_t id, const std::size_t size_b, const std::size_t alignment_b) {
+            if (file_ == nullptr)
+                return;
+            const auto time_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start_);
+            buffer_[buffer_n_++] = { static_cast<u_int64_t>(time_ns.count()), id,
+                                     static_cast<u_int32_t>(size_b), static_cast<u_int32_t>(alignment_b), op, {} };
+            if (buffer_n_ == TRACE_FLUSH_N)
+                flush_();
+        }
+
+        void flush_() {
+            if (file_ != nullptr && buffer_n_ > 0 && std::fwrite(buffer_, sizeof(trace_record), buffer_n_, file_) != buffer_n_)
+                abort_("Cannot write trace records");
+            buffer_n_ = 0;
+        }
+    };
+
+    /**
+     * Reads a whole trace written by the recorder
+     */
+    inline std::vector<trace_record> load(const char *path) {
+        std::FILE *file = std::fopen(path, "rb");
+        if (file == nullptr)
+            abort_("Cannot open trace file");
+
+        trace_header header = {};
+        if (std::fread(&header, sizeof(header), 1, file) != 1 || header.magic != TRACE_MAGIC || header.version != TRACE_VERSION) {
+            std::fclose(file);
+            abort_("Invalid trace file header");
+        }
+
+        std::vector<trace_record> records;
+        trace_record              buffer[TRACE_FLUSH_N];
+        for (std::size_t n; (n = std::fread(buffer, sizeof(trace_record), TRACE_FLUSH_N, file)) > 0;)
+            records.insert(records.end(), buffer, buffer + n);
+
+        std::fclose(file);
+        return records;
+    }
+
+}
+
+#endif //EX_LIMBO_DATA_ALLOCTRACE_H
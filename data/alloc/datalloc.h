@@ -5,8 +5,18 @@
 #ifndef EX_DATALLOC_H
 #define EX_DATALLOC_H
 
+#include "allocstats.h"
 #include <iostream>
 #include <cstdlib>
+#include <cstddef>
+#include <atomic>
+
+#if defined(__GLIBC__)
+#include <malloc.h>
+#define default_usable_size_(ptr, size_b) (::malloc_usable_size(ptr))
+#else
+#define default_usable_size_(ptr, size_b) (size_b + 16)
+#endif
 
 namespace ex::data {
 
@@ -27,39 +37,184 @@ namespace ex::data {
     using free_fn_t    = void  (*) (instance_t this_, void *ptr);
     using size_fn_t    = long  (*) (instance_t this_);
 
-    inline std::size_t default_size_ctr_ = 0;
+    using malloc_batch_fn_t = void (*) (instance_t this_, std::size_t n, std::size_t size_b, std::size_t alignment_b, void **out_ptrs);
+    using free_batch_fn_t   = void (*) (instance_t this_, void *const *ptrs, std::size_t n);
+    using free_sized_fn_t   = void (*) (instance_t this_, void *ptr, std::size_t size_b, std::size_t alignment_b);
+    using try_expand_fn_t   = bool (*) (instance_t this_, void *ptr, std::size_t size_new_b);
+
+#ifndef ALLOC_BATCH_N
+#define ALLOC_BATCH_N (64) // objects per batch call of alloc_batch
+#endif
+
+    // bytes live in the default shim (usable size where libc can tell it)
+    inline std::atomic<long> default_size_ctr_ = 0;
 
-    inline void *default_malloc_(instance_t, const std::size_t size_new_b, std::size_t) {
-        void *mem = ::malloc(size_new_b);
+    alloc_stats_(inline alloc_stats default_stats_;)
+
+    inline void *default_malloc_(instance_t, const std::size_t size_new_b, const std::size_t alignment_b) {
+        void *mem = nullptr;
+        if (alignment_b <= alignof(std::max_align_t))
+            mem = ::malloc(size_new_b);
+        else if (::posix_memalign(&mem, alignment_b, size_new_b) != 0)
+            mem = nullptr;
         if (mem == nullptr)
             ::abort();
-        default_size_ctr_ += size_new_b + 16;
+        const std::size_t size_b = default_usable_size_(mem, size_new_b);
+        default_size_ctr_.fetch_add(static_cast<long>(size_b), std::memory_order_relaxed);
+        alloc_stats_(default_stats_.on_malloc(size_b));
         return mem;
     }
 
     inline void *default_realloc_(instance_t, void *ptr, const std::size_t size_new_b) {
+        #if defined(__GLIBC__)
+        const std::size_t size_old_b = ptr == nullptr ? 0 : ::malloc_usable_size(ptr);
+        #else
+        const std::size_t size_old_b = 0; // unknown, only growth is accounted
+        #endif
         void *mem = ::realloc(ptr, size_new_b);
         if (mem == nullptr)
             ::abort();
-        default_size_ctr_ += size_new_b + 16;
+        const std::size_t size_b = default_usable_size_(mem, size_new_b);
+        default_size_ctr_.fetch_add(static_cast<long>(size_b) - static_cast<long>(size_old_b), std::memory_order_relaxed);
+        alloc_stats_(default_stats_.on_realloc(size_old_b, size_b));
         return mem;
     }
 
     inline void default_free_(instance_t, void *ptr) {
+        #if defined(__GLIBC__)
+        if (ptr != nullptr) {
+            const std::size_t size_b = ::malloc_usable_size(ptr);
+            default_size_ctr_.fetch_sub(static_cast<long>(size_b), std::memory_order_relaxed);
+            alloc_stats_(default_stats_.on_free(size_b));
+        }
+        #endif
         ::free(ptr);
     }
 
     inline long default_size_(instance_t) {
-        return default_size_ctr_;
+        return default_size_ctr_.load(std::memory_order_relaxed);
     }
 
+    /**
+     * Statistics of the default malloc shim, false when compiled without ALLOC_STATS
+     */
+    inline bool default_stats_snapshot(alloc_stats_snapshot *out) {
+        #ifdef ALLOC_STATS
+        default_stats_.snapshot(out);
+        return true;
+        #else
+        (void) out;
+        return false;
+        #endif
+    }
+
+    inline void default_malloc_batch_(instance_t this_, std::size_t n, std::size_t size_b, std::size_t alignment_b, void **out_ptrs);
+    inline void default_free_batch_(instance_t this_, void *const *ptrs, std::size_t n);
+    inline void default_free_sized_(instance_t this_, void *ptr, std::size_t size_b, std::size_t alignment_b);
+    inline bool default_try_expand_(instance_t this_, void *ptr, std::size_t size_new_b);
+
     struct allocator {
-        malloc_fn_t  malloc      = &default_malloc_;
-        realloc_fn_t realloc     = &default_realloc_;
-        free_fn_t    free        = &default_free_;
-        size_fn_t    size_total  = &default_size_;
-        size_fn_t    size_used   = &default_size_;
-        instance_t   instance    = nullptr;
+        malloc_fn_t       malloc       = &default_malloc_;
+        realloc_fn_t      realloc      = &default_realloc_;
+        free_fn_t         free         = &default_free_;
+        malloc_batch_fn_t malloc_batch = &default_malloc_batch_;
+        free_batch_fn_t   free_batch   = &default_free_batch_;
+        free_sized_fn_t   free_sized   = &default_free_sized_;
+        try_expand_fn_t   try_expand   = &default_try_expand_;
+        size_fn_t         size_total   = &default_size_;
+        size_fn_t         size_used    = &default_size_;
+        instance_t        instance     = nullptr;
+    };
+
+    /**
+     * Loop fallback for allocators without a native batch path, <b>this_</b> is the allocator itself
+     */
+    inline void default_malloc_batch_(instance_t this_, const std::size_t n, const std::size_t size_b, const std::size_t alignment_b, void **out_ptrs) {
+        allocator *allocator_ = static_cast<allocator *>(this_);
+        for (std::size_t i = 0; i < n; ++i)
+            out_ptrs[i] = allocator_->malloc(this_, size_b, alignment_b);
+    }
+
+    inline void default_free_batch_(instance_t this_, void *const *ptrs, const std::size_t n) {
+        const allocator *allocator_ = static_cast<allocator *>(this_);
+        if (allocator_->free == nullptr)
+            return;
+        for (std::size_t i = 0; i < n; ++i)
+            if (ptrs[i] != nullptr)
+                allocator_->free(this_, ptrs[i]);
+    }
+
+    inline void default_free_sized_(instance_t this_, void *ptr, const std::size_t, const std::size_t) {
+        const allocator *allocator_ = static_cast<allocator *>(this_);
+        if (allocator_->free != nullptr)
+            allocator_->free(this_, ptr);
+    }
+
+    /**
+     * No in-place growth by default. The malloc shim may still have the block larger than it was asked for
+     */
+    inline bool default_try_expand_(instance_t this_, void *ptr, const std::size_t size_new_b) {
+        #if defined(__GLIBC__)
+        const allocator *allocator_ = static_cast<allocator *>(this_);
+        return allocator_->malloc == &default_malloc_ && ptr != nullptr && ::malloc_usable_size(ptr) >= size_new_b;
+        #else
+        (void) this_;
+        (void) ptr;
+        (void) size_new_b;
+        return false;
+        #endif
+    }
+
+    /**
+     * Turns one-object-at-a-time requests into malloc_batch/free_batch calls of up to ALLOC_BATCH_N objects.
+     * Never prefetches more than <b>expect</b> objects, so nothing is left allocated but unused.
+     * Pending frees are flushed on destruction.
+     */
+    struct alloc_batch {
+        allocator  *allocator_;
+        std::size_t size_b;
+        std::size_t alignment_b;
+        std::size_t expect;
+
+        void       *taken_[ALLOC_BATCH_N];
+        void       *freed_[ALLOC_BATCH_N];
+        std::size_t taken_at = 0;
+        std::size_t taken_n  = 0;
+        std::size_t freed_n  = 0;
+
+        alloc_batch(allocator &allocator_, const std::size_t size_b, const std::size_t alignment_b, const std::size_t expect = 0) :
+            allocator_(&allocator_), size_b(size_b), alignment_b(alignment_b), expect(expect) {
+        }
+
+        alloc_batch(const alloc_batch &other) = delete;
+        alloc_batch &operator = (const alloc_batch &other) = delete;
+
+        ~alloc_batch() {
+            flush();
+        }
+
+        void *take() {
+            if (taken_at == taken_n) {
+                const std::size_t n = expect < ALLOC_BATCH_N ? (expect > 0 ? expect : 1) : ALLOC_BATCH_N;
+                allocator_->malloc_batch(allocator_, n, size_b, alignment_b, taken_);
+                expect   = expect > n ? expect - n : 0;
+                taken_at = 0;
+                taken_n  = n;
+            }
+            return taken_[taken_at++];
+        }
+
+        void put(void *ptr) {
+            freed_[freed_n++] = ptr;
+            if (freed_n == ALLOC_BATCH_N)
+                flush();
+        }
+
+        void flush() {
+            if (freed_n > 0 && allocator_->free_batch != nullptr)
+                allocator_->free_batch(allocator_, freed_, freed_n);
+            freed_n = 0;
+        }
     };
 
     template <typename T>
@@ -70,12 +225,16 @@ namespace ex::data {
         }
 
         static ex::data::allocator allocator(T *this_) {
-            return { .malloc      = &alloc_compat::malloc_,
-                     .realloc     = &alloc_compat::realloc_,
-                     .free        = &alloc_compat::free_,
-                     .size_total  = &alloc_compat::size_total_,
-                     .size_used   = &alloc_compat::size_used_,
-                     .instance    = this_ };
+            return { .malloc       = &alloc_compat::malloc_,
+                     .realloc      = &alloc_compat::realloc_,
+                     .free         = &alloc_compat::free_,
+                     .malloc_batch = &alloc_compat::malloc_batch_,
+                     .free_batch   = &alloc_compat::free_batch_,
+                     .free_sized   = &alloc_compat::free_sized_,
+                     .try_expand   = &alloc_compat::try_expand_,
+                     .size_total   = &alloc_compat::size_total_,
+                     .size_used    = &alloc_compat::size_used_,
+                     .instance     = this_ };
         }
 
         static void *malloc_(void *this_, const std::size_t size_new_b, const std::size_t alignment_b) {
@@ -90,6 +249,41 @@ namespace ex::data {
             static_cast<T *>(static_cast<const ex::data::allocator *>(this_)->instance)->free(ptr);
         }
 
+        static void malloc_batch_(void *this_, const std::size_t n, const std::size_t size_b, const std::size_t alignment_b, void **out_ptrs) {
+            T *instance = static_cast<T *>(static_cast<const ex::data::allocator *>(this_)->instance);
+            if constexpr (requires { instance->malloc_batch(n, size_b, alignment_b, out_ptrs); })
+                instance->malloc_batch(n, size_b, alignment_b, out_ptrs);
+            else
+                for (std::size_t i = 0; i < n; ++i)
+                    out_ptrs[i] = instance->malloc(size_b, alignment_b);
+        }
+
+        static void free_batch_(void *this_, void *const *ptrs, const std::size_t n) {
+            T *instance = static_cast<T *>(static_cast<const ex::data::allocator *>(this_)->instance);
+            if constexpr (requires { instance->free_batch(ptrs, n); })
+                instance->free_batch(ptrs, n);
+            else
+                for (std::size_t i = 0; i < n; ++i)
+                    if (ptrs[i] != nullptr)
+                        instance->free(ptrs[i]);
+        }
+
+        static void free_sized_(void *this_, void *ptr, const std::size_t size_b, const std::size_t alignment_b) {
+            T *instance = static_cast<T *>(static_cast<const ex::data::allocator *>(this_)->instance);
+            if constexpr (requires { instance->free_sized(ptr, size_b, alignment_b); })
+                instance->free_sized(ptr, size_b, alignment_b);
+            else
+                instance->free(ptr);
+        }
+
+        static bool try_expand_(void *this_, void *ptr, const std::size_t size_new_b) {
+            T *instance = static_cast<T *>(static_cast<const ex::data::allocator *>(this_)->instance);
+            if constexpr (requires { instance->try_expand(ptr, size_new_b); })
+                return instance->try_expand(ptr, size_new_b);
+            else
+                return false;
+        }
+
         static long size_total_(void *this_) {
             return static_cast<T *>(static_cast<const ex::data::allocator *>(this_)->instance)->size_total();
         }
@@ -73,9 +73,12 @@ namespace ex::data::lalloc {
     struct memory_node {
         memory_node  *prev_ptr;
         memory_block *block_ptr;
-        void         *bucket_ptr;
+        void         *bucket_ptr;  // free list head slot, nullptr when block is taken
+        memory_node  *free_prev;
+        memory_node  *free_next;
         u_int32_t     size_b;
         u_int32_t     alignment_b;
+        bool          scavenged;   // pages of the free block already handed back
     };
 
     using block_addr_t   = void *;
@@ -86,7 +89,9 @@ namespace ex::data::lalloc {
 #define ARENA_BLOCK_SIZE (sizeof(memory_node))
 #define STACK_BLOCK_SIZE (sizeof(block_bucket_t::lifo_node))
 #define LIFO_BLOCK_SIZE  (16)
-#define BUCKETS_NUM      (32)
+#define BUCKETS_NUM      (32)  // first level: power of two ranges
+#define BUCKETS_SL_LOG   (4)
+#define BUCKETS_SL_NUM   (1 << BUCKETS_SL_LOG) // second level: linear subdivisions of each range
 
     static u_int32_t power_range_r_(const u_int32_t size_b) {
         if (size_b == 0)
@@ -94,7 +99,7 @@ namespace ex::data::lalloc {
         #ifdef __clang__
         return (sizeof(size_b) * 8 - __builtin_clz(size_b) - 1);
         #elif defined(__GNUC__)
-        return return (sizeof(size_b) * 8 - __builtin_clz(size_b) - 1);
+        return (sizeof(size_b) * 8 - __builtin_clz(size_b) - 1);
         #elif defined(_MSC_VER)
         u_int64_t index;
         _BitScanReverse(&index, size_b);
@@ -105,11 +110,26 @@ namespace ex::data::lalloc {
         #endif
     }
 
+    static u_int32_t power_range_l_(const u_int32_t bits) {
+        #ifdef __clang__
+        return __builtin_ctz(bits);
+        #elif defined(__GNUC__)
+        return __builtin_ctz(bits);
+        #elif defined(_MSC_VER)
+        u_int64_t index;
+        _BitScanForward(&index, bits);
+        return static_cast<u_int32_t>(index);
+        #else
+        #error "Compiller not supported"
+        abort_("Compiller not supported");
+        #endif
+    }
+
     static constexpr u_int32_t power_range_r_s64(const u_int64_t size_b) {
         #ifdef __clang__
         return (sizeof(size_b) * 8 - __builtin_clzll(size_b) - 1);
         #elif defined(__GNUC__)
-        return return (sizeof(size_b) * 8 - __builtin_clzll(size_b) - 1);
+        return (sizeof(size_b) * 8 - __builtin_clzll(size_b) - 1);
         #elif defined(_MSC_VER)
         u_int64_t index;
         _BitScanReverse64(&index, size_b);
@@ -176,40 +196,10 @@ namespace ex::data::lalloc {
         };
         #endif
 
-        block_bucket_t buckets_[BUCKETS_NUM] = {
-            stack_.compat(), // 2^0
-            stack_.compat(), // 2^1
-            stack_.compat(), // 2^2
-            stack_.compat(), // 2^3
-            stack_.compat(), // 2^4
-            stack_.compat(), // 2^5
-            stack_.compat(), // 2^6
-            stack_.compat(), // 2^7
-            stack_.compat(), // 2^9
-            stack_.compat(), // 2^10
-            stack_.compat(), // 2^11
-            stack_.compat(), // 2^12
-            stack_.compat(), // 2^13
-            stack_.compat(), // 2^14
-            stack_.compat(), // 2^15
-            stack_.compat(), // 2^16
-            stack_.compat(), // 2^17
-            stack_.compat(), // 2^18
-            stack_.compat(), // 2^19
-            stack_.compat(), // 2^20
-            stack_.compat(), // 2^21
-            stack_.compat(), // 2^22
-            stack_.compat(), // 2^23
-            stack_.compat(), // 2^24
-            stack_.compat(), // 2^25
-            stack_.compat(), // 2^26
-            stack_.compat(), // 2^27
-            stack_.compat(), // 2^28
-            stack_.compat(), // 2^29
-            stack_.compat(), // 2^30
-            stack_.compat(), // 2^31
-            stack_.compat(), // 2^32
-        };
+        // two-level segregated fit index (TLSF), buckets_[fl][sl] are intrusive lists of free nodes
+        memory_node *buckets_[BUCKETS_NUM][BUCKETS_SL_NUM] = {};
+        u_int32_t    fl_bitmap_                            = 0;
+        u_int32_t    sl_bitmap_[BUCKETS_NUM]               = {};
 
         mem_provider memory_;
 
@@ -218,13 +208,20 @@ namespace ex::data::lalloc {
         std::size_t grow_mem_     = 0;
         std::size_t used_mem_     = 0;
         std::size_t blocks_total_ = 0;
-        u_int32_t   min_bucket_   = BUCKETS_NUM;
+        std::size_t blocks_free_  = 0;
+
+        scavenge_stats scavenged_ = {};
+
+        alloc_stats_(alloc_stats stats_;)
 
         ex::data::allocator compat() {
             return alloc_compat<allocator>::allocator(this);
         }
 
-        allocator(const std::size_t pre_allocated = ALLOC_DEF_SIZE_B, const std::size_t max_size = ALLOC_MAX_SIZE_B) {
+        allocator(const std::size_t pre_allocated = ALLOC_DEF_SIZE_B,
+                  const std::size_t max_size      = ALLOC_MAX_SIZE_B,
+                  const mem_policy &policy        = mem_policy::standard()) :
+            memory_(policy) {
             max_size_ = max_size;
             preallocate(pre_allocated);
         }
@@ -242,8 +239,7 @@ namespace ex::data::lalloc {
 
             val_region_del_();
 
-            for (int i = 0; i < BUCKETS_NUM; i++)
-                buckets_[i].clear();
+            index_clear_();
             arena_.clean();
             stack_.clean();
             memory_.clean();
@@ -256,12 +252,13 @@ namespace ex::data::lalloc {
 
             val_region_del_();
 
-            for (int i = 0; i < BUCKETS_NUM; i++)
-                buckets_[i].clear();
+            index_clear_();
             arena_.clean();
             stack_.clean();
             memory_.clean();
-            used_mem_ = 0;
+            used_mem_  = 0;
+            scavenged_ = {};
+            alloc_stats_(stats_.reset());
         }
 
         void preallocate(std::size_t pre_allocated = ALLOC_DEF_SIZE_B) {
@@ -309,6 +306,7 @@ namespace ex::data::lalloc {
 
             if (const block_addr_t allocated = block_acquire_(size_b, alignment_b)) {
                 validate_header_(allocated);
+                alloc_stats_(stats_.on_malloc(block_size_(allocated)));
                 return allocated;
             }
 
@@ -316,6 +314,7 @@ namespace ex::data::lalloc {
 
             if (const block_addr_t allocated = block_acquire_(size_b, alignment_b)) {
                 validate_header_(allocated);
+                alloc_stats_(stats_.on_malloc(block_size_(allocated)));
                 return allocated;
             }
 
@@ -341,22 +340,27 @@ namespace ex::data::lalloc {
                 abort_("Reallocation of free block");
             #endif
 
-            if (size_new_b == static_cast<std::size_t>(block->node_ptr->size_b)) {
+            alloc_stats_(const u_int32_t size_old_b = block->node_ptr->size_b);
+
+            // alignment padding between header and data is a part of the block
+            const u_int32_t data_offset = static_cast<unsigned char *>(ptr) - (h_ptr + sizeof(memory_block));
+            const u_int32_t capacity    = block->node_ptr->size_b - data_offset;
+
+            if (size_new_b == static_cast<std::size_t>(capacity)) {
                 val_restricted(block);
                 return ptr;
             }
 
-            if (size_new_b < static_cast<std::size_t>(block->node_ptr->size_b)) {
-                const u_int32_t size_free = block->node_ptr->size_b - size_new_b;
+            if (size_new_b < static_cast<std::size_t>(capacity)) {
+                const u_int32_t size_free = capacity - size_new_b;
 
                 if (size_free < (2 * sizeof(memory_block))) {
                     val_restricted(block);
                     return ptr; // prevent dead blocks
                 }
 
-                unsigned char *start_ptr = h_ptr + sizeof(memory_block);
-                unsigned char *end_ptr   = start_ptr + size_new_b;
-                const uint32_t padding   = block_padding_(end_ptr, sizeof(memory_block));
+                unsigned char *end_ptr = static_cast<unsigned char *>(ptr) + size_new_b;
+                const uint32_t padding = block_padding_(end_ptr, sizeof(memory_block));
 
                 if ((size_free - padding) < (2 * sizeof(memory_block))) {
                     val_restricted(block);
@@ -377,9 +381,10 @@ namespace ex::data::lalloc {
 
                 used_mem_ -= (block->node_ptr->size_b + sizeof(memory_block));
                 val_free_block(block);
-                block->node_ptr->size_b = size_new_b + padding;
+                block->node_ptr->size_b = data_offset + size_new_b + padding;
 
                 used_mem_ += block->node_ptr->size_b + sizeof(memory_block);
+                alloc_stats_(stats_.on_realloc(size_old_b, block->node_ptr->size_b));
                 val_accessible(block);
                 val_make_block(block);
                 val_restricted(block);
@@ -387,71 +392,11 @@ namespace ex::data::lalloc {
                 return ptr;
             }
 
-            if (memory_block *next_block = next_block_(block)) {
-                val_accessible(next_block);
-                memory_node *next_node = next_block->node_ptr;
-
-                if (next_node->bucket_ptr == nullptr) {
-                    val_restricted(next_block);
-                    goto fallback_go;
-                }
-
-                #ifndef LALLOC_AGGRESSIVE
-                if (next_node->prev_ptr != block->node_ptr)
-                    abort_("Memory layout fragmentation error");
-                if (!continuous_(block, next_block))
-                    abort_("Memory layout fragmentation error");
-                #endif
-
-                const u_int64_t available = next_node->size_b + sizeof(memory_block);
-                const u_int64_t has       = block->node_ptr->size_b;
-                const u_int64_t need      = size_new_b - has;
-
-                if (available < need) {
-                    val_restricted(next_block);
-                    goto fallback_go;
-                }
-
-                const u_int32_t power = power_range_r_(next_node->size_b);
-                buckets_[power].remove(static_cast<block_bucket_t::lifo_node *>(next_node->bucket_ptr));
-                next_node->bucket_ptr = nullptr;
-
-                int32_t p3, // empty "dead" space or padding before FREE block (if p4 exists)
-                        p4; // size of free block (after)
-                calculate_post_(next_block, available, need, &p3, &p4);
-
-                used_mem_ -= (block->node_ptr->size_b + sizeof(memory_block));
-
-                val_free_block(block);
-
-                block->node_ptr->size_b += need;
-
-                if (p3 >= 0)
-                    block->node_ptr->size_b += p3;
-
-                if (p4 >= 0) {
-                    unsigned char *start_ptr = reinterpret_cast<unsigned char *>(next_block);
-                    memory_block *end_block = block_create_(start_ptr + need + p3, p4);
-                    end_block->node_ptr->prev_ptr = block->node_ptr;
-
-                    if (memory_block *next = next_block_(end_block); next != nullptr) {
-                        val_accessible(next);
-                        next->node_ptr->prev_ptr = end_block->node_ptr;
-                        val_restricted(next);
-                    }
-
-                    lifo_put_(end_block);
-                }
-
-                used_mem_ += block->node_ptr->size_b + sizeof(memory_block);
-
-                val_accessible(block);
-                val_make_block(block);
-                val_restricted(block);
+            if (block_expand_(block, capacity, size_new_b)) {
+                alloc_stats_(stats_.on_realloc(size_old_b, block->node_ptr->size_b));
                 return ptr;
             }
 
-        fallback_go:
             const block_addr_t allocated = malloc(size_new_b, block->node_ptr->alignment_b);
 
             if (allocated != ptr) {
@@ -493,11 +438,87 @@ namespace ex::data::lalloc {
             #endif
 
             used_mem_ -= (block->node_ptr->size_b + sizeof(memory_block));
+            alloc_stats_(stats_.on_free(block->node_ptr->size_b));
 
             block->node_ptr->alignment_b = 1;
             lifo_put_(block);
         }
 
+        /**
+         * Grows the block in place (no copy, pointer stays valid), false if the free neighbour is missing or too small
+         */
+        bool try_expand(void *ptr, const std::size_t size_new_b) {
+            if (ptr == nullptr)
+                return false;
+
+            unsigned char *h_ptr = static_cast<unsigned char *>(header_ptr_(ptr));
+            memory_block  *block = reinterpret_cast<memory_block *>(h_ptr);
+            val_accessible(block);
+
+            #ifndef LALLOC_AGGRESSIVE
+            if (block->node_ptr->block_ptr != block)
+                abort_("Invalid block address, block bucket address invalid: " << block << " | " << block->node_ptr->block_ptr);
+            #endif
+
+            alloc_stats_(const u_int32_t size_old_b = block->node_ptr->size_b);
+
+            const u_int32_t data_offset = static_cast<unsigned char *>(ptr) - (h_ptr + sizeof(memory_block));
+            const u_int32_t capacity    = block->node_ptr->size_b - data_offset;
+
+            if (size_new_b <= static_cast<std::size_t>(capacity)) {
+                val_restricted(block);
+                return true;
+            }
+
+            if (block_expand_(block, capacity, size_new_b)) {
+                alloc_stats_(stats_.on_realloc(size_old_b, block->node_ptr->size_b));
+                return true;
+            }
+
+            val_restricted(block);
+            return false;
+        }
+
+        /**
+         * The header is the only way to the block node, size is not needed
+         */
+        void free_sized(const block_addr_t ptr, std::size_t, std::size_t) {
+            free(ptr);
+        }
+
+        /**
+         * Serves the batch from free blocks while they last, on the first miss grows the pool once for the rest of it
+         */
+        void malloc_batch(const std::size_t n, const std::size_t size_b, const std::size_t alignment_b, void **out_ptrs) {
+            const u_int64_t item_b = size_b + alignment_b + sizeof(memory_block);
+            bool            grown  = false;
+
+            for (std::size_t i = 0; i < n; ++i) {
+                block_addr_t allocated = block_acquire_(size_b, alignment_b);
+                if (allocated == nullptr && !grown) {
+                    grown = true;
+                    if (const u_int64_t rest_b = static_cast<u_int64_t>(n - i) * item_b; rest_b < BLOCK_MAX_SIZE_B) {
+                        block_request_(rest_b);
+                        allocated = block_acquire_(size_b, alignment_b);
+                    }
+                }
+
+                if (allocated == nullptr) {
+                    out_ptrs[i] = malloc(size_b, alignment_b);
+                    continue;
+                }
+
+                validate_header_(allocated);
+                alloc_stats_(stats_.on_malloc(block_size_(allocated)));
+                out_ptrs[i] = allocated;
+            }
+        }
+
+        void free_batch(void *const *ptrs, const std::size_t n) {
+            for (std::size_t i = 0; i < n; ++i)
+                free(ptrs[i]);
+        }
+
         long size_used() const {
             const long stack_size = stack_.size_used();
             const long arena_size = arena_.size_used();
@@ -515,15 +536,63 @@ namespace ex::data::lalloc {
         }
 
         long blocks_free() const {
-            u_int32_t free_ = 0;
-            for (int i = 0; i < BUCKETS_NUM; ++i)
-                free_ += buckets_[i].size();
+            u_int32_t free_ = blocks_free_;
             #ifndef LALLOC_LIFO_SKIP
             free_ += lifo_.size();
             #endif
             return free_;
         }
 
+        /**
+         * Hands pages of large free blocks back to the OS, largest blocks first.
+         * Regions that are completely free are unmapped, others are punched (MADV_DONTNEED/MADV_FREE).
+         * Already scavenged blocks are skipped, so repeated calls with a small budget make progress.
+         * @return bytes released by this call
+         */
+        std::size_t scavenge(const scavenge_budget &budget = {}) {
+            const auto start    = std::chrono::steady_clock::now();
+            std::size_t released = 0;
+            scavenged_.calls++;
+
+            u_int32_t fl_min, sl_min;
+            if (!index_map_(budget.min_span_b, &fl_min, &sl_min))
+                return 0;
+
+            for (int32_t fl = BUCKETS_NUM - 1; fl >= static_cast<int32_t>(fl_min); --fl) {
+                if ((fl_bitmap_ & (1U << fl)) == 0)
+                    continue;
+                for (int32_t sl = BUCKETS_SL_NUM - 1; sl >= 0; --sl) {
+                    for (memory_node *node = buckets_[fl][sl], *next; node != nullptr; node = next) {
+                        next = node->free_next;
+                        if (released >= budget.bytes || std::chrono::steady_clock::now() - start >= budget.time)
+                            return released;
+                        if (node->scavenged || node->size_b < budget.min_span_b)
+                            continue;
+                        released += block_scavenge_(node);
+                    }
+                }
+            }
+
+            return released;
+        }
+
+        const scavenge_stats &scavenged() const {
+            return scavenged_;
+        }
+
+        /**
+         * Lock-free, may be called from any thread, false when compiled without ALLOC_STATS
+         */
+        bool stats_snapshot(alloc_stats_snapshot *out) const {
+            #ifdef ALLOC_STATS
+            stats_.snapshot(out);
+            return true;
+            #else
+            (void) out;
+            return false;
+            #endif
+        }
+
         // =========================================== INTERNAL UTILS ==================================================
 
         /**
@@ -585,17 +654,100 @@ namespace ex::data::lalloc {
                     return ptr;
             #endif
 
-            const u_int32_t power = power_range_r_(size_b);
-            for (u_int32_t i = power > min_bucket_ ? power : min_bucket_; i < BUCKETS_NUM; i++) {
-                if (buckets_[i].empty())
-                    continue;
-                if (void *ptr = bucket_scan_(buckets_[i], size_b, alignment_b))
-                    return ptr;
+            // good fit, every block of the list found is big enough unless alignment padding gets in the way
+            if (memory_node *node = index_search_(size_b); node != nullptr && block_fits_(node, size_b, alignment_b)) {
+                bucket_remove_(node);
+                return block_split_(node, size_b, alignment_b);
+            }
+
+            if (alignment_b <= sizeof(memory_block))
+                return nullptr;
+
+            // worst case padding included
+            if (memory_node *node = index_search_(size_b + alignment_b + 2 * sizeof(memory_block));
+                node != nullptr && block_fits_(node, size_b, alignment_b)) {
+                bucket_remove_(node);
+                return block_split_(node, size_b, alignment_b);
             }
 
             return nullptr;
         }
 
+        /**
+         * Grows the block in place by taking the head of the free neighbour, false if it can't.
+         * Block header is expected to be accessible
+         */
+        bool block_expand_(memory_block *block, const u_int32_t capacity, const std::size_t size_new_b) {
+            memory_block *next_block = next_block_(block);
+            if (next_block == nullptr)
+                return false;
+
+            val_accessible(next_block);
+            memory_node *next_node = next_block->node_ptr;
+
+            if (next_node->bucket_ptr == nullptr) {
+                val_restricted(next_block);
+                return false;
+            }
+
+            #ifndef LALLOC_AGGRESSIVE
+            if (next_node->prev_ptr != block->node_ptr)
+                abort_("Memory layout fragmentation error");
+            if (!continuous_(block, next_block))
+                abort_("Memory layout fragmentation error");
+            #endif
+
+            const u_int64_t available = next_node->size_b + sizeof(memory_block);
+            const u_int64_t need      = size_new_b - capacity;
+
+            if (available < need) {
+                val_restricted(next_block);
+                return false;
+            }
+
+            bucket_remove_(next_node);
+
+            int32_t p3, // empty "dead" space or padding before FREE block (if p4 exists)
+                    p4; // size of free block (after)
+            calculate_post_(next_block, available, need, &p3, &p4);
+
+            used_mem_ -= (block->node_ptr->size_b + sizeof(memory_block));
+
+            val_free_block(block);
+
+            block->node_ptr->size_b += need;
+
+            if (p3 >= 0)
+                block->node_ptr->size_b += p3;
+
+            if (p4 >= 0) {
+                unsigned char *start_ptr = reinterpret_cast<unsigned char *>(next_block);
+                memory_block *end_block = block_create_(start_ptr + need + p3, p4);
+                end_block->node_ptr->prev_ptr = block->node_ptr;
+
+                if (memory_block *next = next_block_(end_block); next != nullptr) {
+                    val_accessible(next);
+                    next->node_ptr->prev_ptr = end_block->node_ptr;
+                    val_restricted(next);
+                }
+
+                lifo_put_(end_block);
+            } else if (memory_block *next = next_block_(block); next != nullptr) {
+                // neighbour absorbed completely
+                val_accessible(next);
+                next->node_ptr->prev_ptr = block->node_ptr;
+                val_restricted(next);
+            }
+
+            release_node_(next_node);
+            used_mem_ += block->node_ptr->size_b + sizeof(memory_block);
+
+            val_accessible(block);
+            val_make_block(block);
+            val_restricted(block);
+            return true;
+        }
+
         void lifo_put_(memory_block *block) {
             #ifndef LALLOC_AGGRESSIVE
             if (block->node_ptr->bucket_ptr != nullptr)
@@ -627,30 +779,131 @@ namespace ex::data::lalloc {
         }
 
         void bucket_put_(memory_block *block) {
-            const u_int32_t power = power_range_r_(block->node_ptr->size_b);
+            memory_node *node = block->node_ptr;
 
-            #ifndef LALLOC_AGGRESSIVE
-            if (power >= BUCKETS_NUM)
+            u_int32_t fl, sl;
+            if (!index_map_(node->size_b, &fl, &sl))
                 abort_("Block size too big");
-            #endif
 
-            min_bucket_ = power < min_bucket_ ? power : min_bucket_;
+            memory_node *&head = buckets_[fl][sl];
+            node->free_prev = nullptr;
+            node->free_next = head;
+            if (head != nullptr)
+                head->free_prev = node;
+            head = node;
+
+            node->bucket_ptr = &head;
+            node->scavenged  = false;
+            fl_bitmap_     |= (1U << fl);
+            sl_bitmap_[fl] |= (1U << sl);
+            blocks_free_++;
 
-            void *ptr = buckets_[power].push(block->node_ptr);
-            block->node_ptr->bucket_ptr = ptr;
+            alloc_stats_(stats_.on_block_free(node->size_b));
+            alloc_stats_(if (node->size_b > stats_.largest()) stats_.on_largest(node->size_b));
 
             val_dead_block(block);
         }
 
+        void bucket_remove_(memory_node *node) {
+            memory_node **head = static_cast<memory_node **>(node->bucket_ptr);
+
+            if (node->free_prev != nullptr)
+                node->free_prev->free_next = node->free_next;
+            else
+                *head = node->free_next;
+
+            if (node->free_next != nullptr)
+                node->free_next->free_prev = node->free_prev;
+
+            if (*head == nullptr) {
+                const long      index = head - &buckets_[0][0];
+                const u_int32_t fl    = index / BUCKETS_SL_NUM;
+                const u_int32_t sl    = index % BUCKETS_SL_NUM;
+                sl_bitmap_[fl] &= ~(1U << sl);
+                if (sl_bitmap_[fl] == 0)
+                    fl_bitmap_ &= ~(1U << fl);
+            }
+
+            node->bucket_ptr = nullptr;
+            node->free_prev  = nullptr;
+            node->free_next  = nullptr;
+            blocks_free_--;
+
+            alloc_stats_(stats_.on_block_taken(node->size_b));
+            alloc_stats_(if (node->size_b == stats_.largest()) stats_.on_largest(largest_free_()));
+        }
+
+        u_int64_t largest_free_() const {
+            if (fl_bitmap_ == 0)
+                return 0;
+            const u_int32_t fl      = power_range_r_(fl_bitmap_);
+            const u_int32_t sl      = power_range_r_(sl_bitmap_[fl]);
+            u_int64_t       largest = 0;
+            for (const memory_node *node = buckets_[fl][sl]; node != nullptr; node = node->free_next)
+                largest = node->size_b > largest ? node->size_b : largest;
+            return largest;
+        }
+
+        static u_int32_t block_size_(void *ptr) {
+            memory_block *block = static_cast<memory_block *>(header_ptr_(ptr));
+            val_accessible(block);
+            const u_int32_t size_b = block->node_ptr->size_b;
+            val_restricted(block);
+            return size_b;
+        }
+
+        /**
+         * First non-empty list whose every block is at least <b>size_b</b> bytes, O(1)
+         */
+        memory_node *index_search_(const u_int64_t size_b) const {
+            u_int64_t size = size_b;
+            if (size >= BUCKETS_SL_NUM) // round up to the next list
+                size += (1ULL << (power_range_r_s64(size) - BUCKETS_SL_LOG)) - 1;
+
+            u_int32_t fl, sl;
+            if (!index_map_(size, &fl, &sl))
+                return nullptr;
+
+            u_int32_t sl_map = sl_bitmap_[fl] & (~0U << sl);
+            if (sl_map == 0) {
+                const u_int32_t fl_map = (fl + 1 < BUCKETS_NUM) ? (fl_bitmap_ & (~0U << (fl + 1))) : 0;
+                if (fl_map == 0)
+                    return nullptr;
+                fl     = power_range_l_(fl_map);
+                sl_map = sl_bitmap_[fl];
+            }
+
+            return buckets_[fl][power_range_l_(sl_map)];
+        }
+
+        void index_clear_() {
+            for (int i = 0; i < BUCKETS_NUM; ++i) {
+                for (int j = 0; j < BUCKETS_SL_NUM; ++j)
+                    buckets_[i][j] = nullptr;
+                sl_bitmap_[i] = 0;
+            }
+            fl_bitmap_   = 0;
+            blocks_free_ = 0;
+        }
+
+        static bool index_map_(const u_int64_t size_b, u_int32_t *fl, u_int32_t *sl) {
+            if (size_b < BUCKETS_SL_NUM) {
+                *fl = 0;
+                *sl = static_cast<u_int32_t>(size_b);
+                return true;
+            }
+            const u_int32_t power = power_range_r_s64(size_b);
+            *fl = power - BUCKETS_SL_LOG + 1;
+            *sl = static_cast<u_int32_t>(size_b >> (power - BUCKETS_SL_LOG)) - BUCKETS_SL_NUM;
+            return *fl < BUCKETS_NUM;
+        }
+
         void block_merge_(memory_block *block) {
             memory_block *target_block = block;
             memory_node  *node         = block->node_ptr;
 
-            if (node->bucket_ptr != nullptr) {
-                const u_int32_t p = power_range_r_(node->size_b);
-                buckets_[p].remove(static_cast<block_bucket_t::lifo_node *>(node->bucket_ptr));
-                node->bucket_ptr = nullptr;
-            }
+            if (node->bucket_ptr != nullptr)
+                bucket_remove_(node);
 
             if (memory_block *next_block = next_block_(block)) {
                 val_accessible(next_block);
@@ -662,9 +915,7 @@ namespace ex::data::lalloc {
                         abort_("block layout discontinuity");
                     #endif
 
-                    const u_int32_t p = power_range_r_(next_node->size_b);
-                    buckets_[p].remove(static_cast<block_bucket_t::lifo_node *>(next_node->bucket_ptr));
-                    next_node->bucket_ptr = nullptr;
+                    bucket_remove_(next_node);
 
                     node->size_b += next_node->size_b + sizeof(memory_block);
                     release_node_(next_node);
@@ -677,10 +928,8 @@ namespace ex::data::lalloc {
                     prev_node->bucket_ptr != nullptr) {
                     val_accessible(prev_block);
 
-                    const u_int32_t p = power_range_r_(prev_node->size_b);
-                    buckets_[p].remove(static_cast<block_bucket_t::lifo_node *>(prev_node->bucket_ptr));
+                    bucket_remove_(prev_node);
 
-                    prev_node->bucket_ptr = nullptr;
                     prev_node->size_b += (node->size_b + sizeof(memory_block));
                     release_node_(node);
 
@@ -704,6 +953,31 @@ namespace ex::data::lalloc {
             bucket_put_(target_block);
         }
 
+        std::size_t block_scavenge_(memory_node *node) {
+            memory_block *block = node->block_ptr;
+
+            #ifndef LALLOC_USE_VALGRIND
+            if (node->prev_ptr == nullptr && next_block_(block) == nullptr) {
+                // the only block of the region
+                if (const std::size_t mapping = memory_.mapping_size(block); mapping > 0) {
+                    bucket_remove_(node);
+                    release_node_(node);
+                    memory_.release(block);
+
+                    grow_mem_ = grow_mem_ > mapping + def_size_ ? grow_mem_ - mapping : def_size_;
+                    scavenged_.unmapped_b += mapping;
+                    scavenged_.regions_n++;
+                    return mapping;
+                }
+            }
+            #endif
+
+            const std::size_t punched = memory_.punch(reinterpret_cast<unsigned char *>(block) + sizeof(memory_block), node->size_b);
+            node->scavenged = true;
+            scavenged_.released_b += punched;
+            return punched;
+        }
+
         memory_block *block_create_(void *mem, const u_int32_t size) {
             val_accessible(mem);
             memory_block *new_block = reinterpret_cast<memory_block *>(mem);
@@ -712,6 +986,9 @@ namespace ex::data::lalloc {
             new_node->block_ptr   = new_block;
             new_node->bucket_ptr  = nullptr;
             new_node->prev_ptr    = nullptr;
+            new_node->free_prev   = nullptr;
+            new_node->free_next   = nullptr;
+            new_node->scavenged   = false;
             new_node->size_b      = size;
             new_node->alignment_b = 1;
 
@@ -732,124 +1009,132 @@ namespace ex::data::lalloc {
 
         void *bucket_scan_(block_bucket_t &bucket, const std::size_t size_b, const std::size_t alignment_b) {
             for (block_bucket_t::lifo_node *head = bucket.peek(); head != nullptr; head = head->prev) {
-                memory_node  *node  = head->val;
-                memory_block *block = node->block_ptr;
-                val_accessible(block);
-
-                #ifndef LALLOC_AGGRESSIVE
-                if (node->block_ptr != block)
-                    abort_("Invalid block address, block bucket address invalid: " << block << " | " << node->block_ptr);
-                #endif
-
-                if (static_cast<std::size_t>(node->size_b) < size_b) {
-                    val_restricted(block);
+                memory_node *node = head->val;
+                if (!block_fits_(node, size_b, alignment_b))
                     continue;
-                }
 
-                unsigned char *byte_ptr = reinterpret_cast<unsigned char *>(block) + sizeof(memory_block);
+                node->bucket_ptr = nullptr;
+                bucket.remove(head);
+                return block_split_(node, size_b, alignment_b);
+            }
 
-                int32_t p1, // natural padding or size of the block (if p2 exists)
-                        p2; // natural padding before data block
-                calculate_pre_(byte_ptr, alignment_b, &p1, &p2);
+            return nullptr;
+        }
 
-                int32_t offset = 0;
-                if (p1 >= 0)
-                    offset += p1;
+        static bool block_fits_(const memory_node *node, const std::size_t size_b, const std::size_t alignment_b) {
+            if (static_cast<std::size_t>(node->size_b) < size_b)
+                return false;
 
-                if (p2 >= 0)
-                    offset += p2 + sizeof(memory_block);
+            unsigned char *byte_ptr = reinterpret_cast<unsigned char *>(node->block_ptr) + sizeof(memory_block);
 
-                const int32_t size_have = static_cast<int32_t>(node->size_b) - offset;
-                if (size_have < size_b) {
-                    val_restricted(block);
-                    continue;
-                }
+            int32_t p1, p2;
+            calculate_pre_(byte_ptr, alignment_b, &p1, &p2);
 
-                unsigned char *start_ptr = byte_ptr + offset;
+            return static_cast<int64_t>(node->size_b) - offset_(p1, p2) >= static_cast<int64_t>(size_b);
+        }
 
-                int32_t p3, // empty "dead" space or padding before FREE block (if p4 exists)
-                        p4; // size of free block (after)
-                calculate_post_(start_ptr, size_have, size_b, &p3, &p4);
+        /**
+         * Carves <b>size_b</b> bytes out of the (already unindexed) free block, leftovers are put back
+         */
+        void *block_split_(memory_node *node, const std::size_t size_b, const std::size_t alignment_b) {
+            memory_block *block = node->block_ptr;
+            val_accessible(block);
 
-                memory_block *work_block = block;
-                memory_block *lifo_block = nullptr;
-                bool          remove_og  = false;
-                bool          reinsert_  = false;
+            #ifndef LALLOC_AGGRESSIVE
+            if (block->node_ptr != node)
+                abort_("Invalid block address, block node address invalid: " << block->node_ptr << " | " << node);
+            #endif
 
-                if (p1 < 0 && p2 < 0) {
-                    node->size_b = static_cast<u_int32_t>(size_b);
-                    remove_og    = true;
-                }
+            unsigned char *byte_ptr = reinterpret_cast<unsigned char *>(block) + sizeof(memory_block);
 
-                else if (p1 >= 0 && p2 < 0) {
-                    node->size_b = static_cast<u_int32_t>(size_b + p1);
-                    remove_og    = true;
-                }
+            int32_t p1, // natural padding or size of the block (if p2 exists)
+                    p2; // natural padding before data block
+            calculate_pre_(byte_ptr, alignment_b, &p1, &p2);
 
-                else if (p1 >= 0 && p2 >= 0) {
-                    // free og block
-                    node->alignment_b = static_cast<u_int16_t>(1);
-                    node->size_b      = static_cast<u_int32_t>(p1);
+            const int32_t offset    = offset_(p1, p2);
+            const int32_t size_have = static_cast<int32_t>(node->size_b) - offset;
 
-                    remove_og = true;
-                    reinsert_ = true;
+            unsigned char *start_ptr = byte_ptr + offset;
 
-                    // new padded block
-                    work_block = block_create_(byte_ptr + p1, size_b + p2);
-                    work_block->node_ptr->prev_ptr = node;
-                }
+            int32_t p3, // empty "dead" space or padding before FREE block (if p4 exists)
+                    p4; // size of free block (after)
+            calculate_post_(start_ptr, size_have, size_b, &p3, &p4);
 
-                if (p3 >= 0) {
-                    work_block->node_ptr->size_b += p3;
-                }
+            memory_block *work_block = block;
+            memory_block *lifo_block = nullptr;
+            bool          reinsert_  = false;
 
-                if (p4 >= 0) {
-                    memory_block *end_block = block_create_(start_ptr + size_b + p3, p4);
-                    end_block->node_ptr->prev_ptr = work_block->node_ptr;
+            if (p1 < 0 && p2 < 0) {
+                node->size_b = static_cast<u_int32_t>(size_b);
+            }
 
-                    if (memory_block *next = next_block_(end_block); next != nullptr) {
-                        val_accessible(next);
-                        next->node_ptr->prev_ptr = end_block->node_ptr;
-                        val_restricted(next);
-                    }
+            else if (p1 >= 0 && p2 < 0) {
+                node->size_b = static_cast<u_int32_t>(size_b + p1);
+            }
 
-                    lifo_block = end_block;
-                }
+            else if (p1 >= 0 && p2 >= 0) {
+                // free og block
+                node->alignment_b = static_cast<u_int16_t>(1);
+                node->size_b      = static_cast<u_int32_t>(p1);
+                reinsert_         = true;
 
-                if (p4 < 0 && p1 >= 0 && p2 >= 0) {
-                    if (memory_block *next = next_block_(work_block); next != nullptr) {
-                        val_accessible(next);
-                        next->node_ptr->prev_ptr = work_block->node_ptr;
-                        val_restricted(next);
-                    }
-                }
+                // new padded block
+                work_block = block_create_(byte_ptr + p1, size_b + p2);
+                work_block->node_ptr->prev_ptr = node;
+            }
 
-                work_block->node_ptr->alignment_b = static_cast<u_int16_t>(alignment_b);
+            if (p3 >= 0) {
+                work_block->node_ptr->size_b += p3;
+            }
 
-                used_mem_ += (work_block->node_ptr->size_b + sizeof(memory_block));
+            if (p4 >= 0) {
+                memory_block *end_block = block_create_(start_ptr + size_b + p3, p4);
+                end_block->node_ptr->prev_ptr = work_block->node_ptr;
 
-                if (remove_og) {
-                    head->val->bucket_ptr = nullptr;
-                    bucket.remove(head);
+                if (memory_block *next = next_block_(end_block); next != nullptr) {
+                    val_accessible(next);
+                    next->node_ptr->prev_ptr = end_block->node_ptr;
+                    val_restricted(next);
                 }
 
-                if (reinsert_) {
-                    lifo_put_(block);
-                }
+                lifo_block = end_block;
+            }
 
-                if (lifo_block != nullptr) {
-                    lifo_put_(lifo_block);
+            if (p4 < 0 && p1 >= 0 && p2 >= 0) {
+                if (memory_block *next = next_block_(work_block); next != nullptr) {
+                    val_accessible(next);
+                    next->node_ptr->prev_ptr = work_block->node_ptr;
+                    val_restricted(next);
                 }
+            }
 
-                val_accessible(work_block);
-                val_make_block(work_block);
-                block_init_(work_block);
-                val_restricted(work_block);
+            work_block->node_ptr->alignment_b = static_cast<u_int16_t>(alignment_b);
 
-                return start_ptr;
+            used_mem_ += (work_block->node_ptr->size_b + sizeof(memory_block));
+
+            if (reinsert_) {
+                lifo_put_(block);
             }
 
-            return nullptr;
+            if (lifo_block != nullptr) {
+                lifo_put_(lifo_block);
+            }
+
+            val_accessible(work_block);
+            val_make_block(work_block);
+            block_init_(work_block);
+            val_restricted(work_block);
+
+            return start_ptr;
+        }
+
+        static int32_t offset_(const int32_t p1, const int32_t p2) {
+            int32_t offset = 0;
+            if (p1 >= 0)
+                offset += p1;
+            if (p2 >= 0)
+                offset += p2 + static_cast<int32_t>(sizeof(memory_block));
+            return offset;
         }
 
         static void calculate_post_(void *ptr, const int32_t size_have, const int32_t size_need, int32_t *p3, int32_t *p4) {
@@ -899,8 +1184,8 @@ namespace ex::data::lalloc {
             }
 
             if (static_cast<size_t>(padding_1) == sizeof(memory_block)) {
-                // prevent header-only (empty) block
-                padding_1 += static_cast<u_int32_t>(sizeof(memory_block));
+                // prevent header-only (empty) block, next aligned address
+                padding_1 += static_cast<u_int32_t>(alignment_b);
             }
 
             unsigned char *zero_ptr = reinterpret_cast<unsigned char *>(ptr);
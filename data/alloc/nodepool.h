@@ -0,0 +1,195 @@
+//
+// Created by henryco on 17/10/26.
+//
+
+#ifndef EX_LIMBO_DATA_NODEPOOL_H
+#define EX_LIMBO_DATA_NODEPOOL_H
+
+#include "datalloc.h"
+#include <cstdint>
+
+namespace ex::data::nodepool {
+
+// -----------------------------
+#ifndef NODEPOOL_CHUNK_MIN_N
+#define NODEPOOL_CHUNK_MIN_N (64)   // slots in the first chunk
+#endif
+
+#ifndef NODEPOOL_CHUNK_MAX_N
+#define NODEPOOL_CHUNK_MAX_N (4096) // chunks double up to this many slots
+#endif
+// -----------------------------
+
+    struct free_slot {
+        free_slot *next;
+    };
+
+    struct chunk_header {
+        chunk_header *next;
+        std::size_t   slots_n;
+    };
+
+    /**
+     * Fixed size object pool for container nodes.
+     * Slots are carved out of chunks taken from the <b>upstream</b> allocator, released slots go to an intrusive free list.
+     * <b>reset()</b> drops every object at once: all chunks but the newest (largest) go back upstream,
+     * that one is reused from its start.
+     */
+    struct allocator {
+
+        ex::data::allocator upstream_;
+
+        std::size_t slot_b;
+        std::size_t alignment_b;
+
+        chunk_header  *chunks_ = nullptr; // newest first
+        free_slot     *free_   = nullptr;
+        unsigned char *bump_   = nullptr;
+        unsigned char *end_    = nullptr;
+
+        std::size_t next_n_   = NODEPOOL_CHUNK_MIN_N;
+        std::size_t total_b_  = 0;
+        std::size_t used_n_   = 0;
+
+        ex::data::allocator compat() {
+            return alloc_compat<allocator>::allocator(this);
+        }
+
+        allocator(const ex::data::allocator &upstream, const std::size_t size_b, const std::size_t alignment_b):
+            upstream_(upstream),
+            slot_b(align_up_(size_b < sizeof(free_slot) ? sizeof(free_slot) : size_b,
+                             alignment_b < alignof(free_slot) ? alignof(free_slot) : alignment_b)),
+            alignment_b(alignment_b < alignof(free_slot) ? alignof(free_slot) : alignment_b) {
+        }
+
+        allocator(const allocator &other) = delete;
+        allocator(allocator &&other)      = delete;
+
+        allocator &operator = (const allocator &other) = delete;
+        allocator &operator = (allocator &&other)      = delete;
+
+        ~allocator() {
+            clean();
+        }
+
+        /**
+         * Gives every chunk back upstream
+         */
+        void clean() {
+            release_chunks_(chunks_);
+            chunks_ = nullptr;
+            free_   = nullptr;
+            bump_   = nullptr;
+            end_    = nullptr;
+            next_n_ = NODEPOOL_CHUNK_MIN_N;
+            used_n_ = 0;
+        }
+
+        /**
+         * Forgets every live object (no destructors run), keeps the newest chunk
+         */
+        void reset() {
+            if (chunks_ == nullptr)
+                return;
+            release_chunks_(chunks_->next);
+            chunks_->next = nullptr;
+            total_b_      = chunk_b_(chunks_->slots_n);
+            free_         = nullptr;
+            bump_         = first_slot_(chunks_);
+            end_          = bump_ + chunks_->slots_n * slot_b;
+            used_n_       = 0;
+        }
+
+        void *malloc(const std::size_t size_b, const std::size_t alignment_b) {
+            if (size_b > slot_b || alignment_b > this->alignment_b)
+                abort_("Node pool slot is too small for the request");
+
+            used_n_++;
+            if (free_ != nullptr) {
+                free_slot *slot = free_;
+                free_ = slot->next;
+                return slot;
+            }
+
+            if (bump_ == end_)
+                chunk_request_();
+
+            void *ptr = bump_;
+            bump_ += slot_b;
+            return ptr;
+        }
+
+        void *realloc(void *ptr, const std::size_t size_new_b) {
+            if (size_new_b > slot_b)
+                abort_("Node pool slots can not grow");
+            return ptr;
+        }
+
+        void free(void *ptr) {
+            if (ptr == nullptr)
+                return;
+            free_slot *slot = static_cast<free_slot *>(ptr);
+            slot->next = free_;
+            free_      = slot;
+            used_n_--;
+        }
+
+        void malloc_batch(const std::size_t n, const std::size_t size_b, const std::size_t alignment_b, void **out_ptrs) {
+            for (std::size_t i = 0; i < n; ++i)
+                out_ptrs[i] = malloc(size_b, alignment_b);
+        }
+
+        void free_batch(void *const *ptrs, const std::size_t n) {
+            for (std::size_t i = 0; i < n; ++i)
+                free(ptrs[i]);
+        }
+
+        long size_total() const {
+            return static_cast<long>(total_b_);
+        }
+
+        long size_used() const {
+            return static_cast<long>(used_n_ * slot_b);
+        }
+
+        // =========================================== INTERNAL UTILS ==================================================
+
+        void chunk_request_() {
+            const std::size_t n = next_n_;
+            auto *chunk = static_cast<chunk_header *>(upstream_.malloc(&upstream_, chunk_b_(n), alignment_b > alignof(chunk_header) ? alignment_b : alignof(chunk_header)));
+            chunk->next    = chunks_;
+            chunk->slots_n = n;
+            chunks_        = chunk;
+            total_b_      += chunk_b_(n);
+
+            bump_   = first_slot_(chunk);
+            end_    = bump_ + n * slot_b;
+            next_n_ = n * 2 > NODEPOOL_CHUNK_MAX_N ? NODEPOOL_CHUNK_MAX_N : n * 2;
+        }
+
+        void release_chunks_(chunk_header *chunk) {
+            while (chunk != nullptr) {
+                chunk_header *next = chunk->next;
+                total_b_ -= chunk_b_(chunk->slots_n);
+                if (upstream_.free != nullptr)
+                    upstream_.free(&upstream_, chunk);
+                chunk = next;
+            }
+        }
+
+        unsigned char *first_slot_(chunk_header *chunk) const {
+            return reinterpret_cast<unsigned char *>(chunk) + align_up_(sizeof(chunk_header), alignment_b);
+        }
+
+        std::size_t chunk_b_(const std::size_t slots_n) const {
+            return align_up_(sizeof(chunk_header), alignment_b) + slots_n * slot_b;
+        }
+
+        static std::size_t align_up_(const std::size_t size_b, const std::size_t alignment_b) {
+            return (size_b + alignment_b - 1) & ~(alignment_b - 1);
+        }
+    };
+
+}
+
+#endif //EX_LIMBO_DATA_NODEPOOL_H
@@ -5,14 +5,83 @@
 #ifndef EX_LIMBO_DATA_MEMPROVIDER_H
 #define EX_LIMBO_DATA_MEMPROVIDER_H
 
+#include "datalloc.h"
+#include <chrono>
+
+// -----------------------------
+#ifndef MEM_HUGE_PAGE_SIZE
+#define MEM_HUGE_PAGE_SIZE (2 MB)
+#endif
+
+#ifndef MEM_RETAIN_LIMIT
+#define MEM_RETAIN_LIMIT   (64 MB)
+#endif
+
+#ifndef SCAVENGE_MIN_SPAN
+#define SCAVENGE_MIN_SPAN  (64 KB)
+#endif
+// -----------------------------
+
+#define MEM_NUMA_NONE  (-1)
+#define MEM_NUMA_LOCAL (-2) // node of the cpu that touches the page first
+
+namespace ex::data {
+
+    /**
+     * Limits of a single scavenge call, whichever runs out first (checked between blocks)
+     */
+    struct scavenge_budget {
+        std::size_t              bytes      = static_cast<std::size_t>(-1);
+        std::chrono::nanoseconds time       = std::chrono::nanoseconds::max();
+        std::size_t              min_span_b = SCAVENGE_MIN_SPAN; // smaller free spans are not worth a syscall
+    };
+
+    struct scavenge_stats {
+        std::size_t calls;
+        std::size_t released_b; // free pages advised away (MADV_DONTNEED/MADV_FREE), upper bound
+        std::size_t unmapped_b; // completely free regions handed back to mem_provider
+        std::size_t regions_n;
+    };
+
+    /**
+     * How mem_provider maps memory. Every option is best effort,
+     * unsupported or failing ones degrade to plain anonymous mapping.
+     */
+    struct mem_policy {
+        bool huge_tlb    = false;         // explicit MAP_HUGETLB pages, regular pages when the pool is exhausted
+        bool huge_advice = true;          // transparent huge pages (MADV_HUGEPAGE)
+        bool populate    = false;         // prefault (MAP_POPULATE)
+        int  numa_node   = MEM_NUMA_NONE; // MEM_NUMA_LOCAL or node id (< 64) to bind pages to
+
+        std::size_t retain_b    = MEM_RETAIN_LIMIT; // released mappings kept for reuse, 0 unmaps right away
+        bool        retain_lazy = false;            // MADV_FREE retained pages instead of MADV_DONTNEED,
+                                                    // cheaper, but reused memory is no longer guaranteed zeroed
+
+        static constexpr mem_policy standard() {
+            return {};
+        }
+
+        static constexpr mem_policy huge_pages() {
+            return { .huge_tlb = true, .huge_advice = true };
+        }
+
+        static constexpr mem_policy prefaulted() {
+            return { .huge_advice = true, .populate = true };
+        }
+
+        static constexpr mem_policy numa_local() {
+            return { .huge_advice = true, .numa_node = MEM_NUMA_LOCAL };
+        }
+    };
+}
+
 #if defined(__linux__)
 
 #include <sys/mman.h>
+#include <sys/syscall.h>
 #include <unistd.h>
 #include <cstdint>
 
-#include "datalloc.h"
-
 #ifdef MEM_PROVIDER_VALGRIND
         #include <valgrind/memcheck.h>
 // TODO
@@ -28,6 +97,7 @@ namespace ex::data {
             void     *data;
             mem_node *prev;
             mem_node *orgn;
+            mem_node *link; // spare or retained list
             int64_t   size;
         };
 
@@ -37,18 +107,37 @@ namespace ex::data {
         int64_t   page_size;
         mem_node *node_head;
 
-        mem_provider() :
+        mem_policy policy_;
+
+        mem_node **table_;     // open addressing (linear probing), mapping address -> node
+        int64_t    table_cap_;
+        int64_t    table_n_;
+
+        mem_node  *spare_;     // released node slots, reused before new ones are carved
+        mem_node  *retained_;  // released mappings kept for reuse
+        int64_t    retained_b_;
+        int64_t    mapped_b_;
+
+        mem_provider(const mem_policy &policy = mem_policy::standard()) :
             node_num_(0),
             node_ctr_(0),
             page_size(sysconf(_SC_PAGESIZE)),
-            node_head(nullptr) {
+            node_head(nullptr),
+            policy_(policy),
+            table_(nullptr),
+            table_cap_(0),
+            table_n_(0),
+            spare_(nullptr),
+            retained_(nullptr),
+            retained_b_(0),
+            mapped_b_(0) {
             if (page_size == -1) {
                 abort_("page_size read error");
             }
         }
 
         ~mem_provider() {
-            if (node_head == nullptr)
+            if (node_head == nullptr && table_ == nullptr)
                 return;
             clean();
         }
@@ -67,69 +156,259 @@ namespace ex::data {
                 }
                 head = prev;
             }
-            node_head = nullptr;
-            node_num_ = 0;
-            node_ctr_ = 0;
+            if (table_ != nullptr) {
+                if (const int err = ::munmap(table_, table_cap_ * sizeof(mem_node *)); err != 0)
+                    abort_("munmap deallocation error: " << err);
+            }
+            node_head   = nullptr;
+            node_num_   = 0;
+            node_ctr_   = 0;
+            table_      = nullptr;
+            table_cap_  = 0;
+            table_n_    = 0;
+            spare_      = nullptr;
+            retained_   = nullptr;
+            retained_b_ = 0;
+            mapped_b_   = 0;
         }
 
+        /**
+         * Bytes of live mappings, retained ones excluded
+         */
         long size() const {
-            // TODO FIXME
-            long            bytes = 0;
-            const mem_node *head  = node_head;
-            while (head != nullptr) {
-                bytes += head->size;
-                head = head->prev;
-            }
-            return bytes;
+            return static_cast<long>(mapped_b_);
+        }
+
+        long size_retained() const {
+            return static_cast<long>(retained_b_);
         }
 
         void *request(const std::size_t size, std::size_t *size_allocated = nullptr) {
             const std::size_t need_size = size;
-            const std::size_t real_size = (need_size % page_size != 0)
-                ? (need_size - (need_size % page_size) + page_size)
-                : (need_size);
+            std::size_t       real_size = round_(need_size, page_size);
+
+            const bool bind = policy_.numa_node != MEM_NUMA_NONE;
+
+            if (mem_node *node = retained_take_(real_size); node != nullptr) {
+                if (policy_.populate)
+                    prefault_(node->data, node->size);
+                table_put_(node);
+                mapped_b_ += node->size;
+                if (size_allocated != nullptr)
+                    *size_allocated = node->size;
+                return node->data;
+            }
 
             constexpr int prot = PROT_READ | PROT_WRITE;
-            constexpr int flag = MAP_PRIVATE | MAP_ANONYMOUS;
+            int           flag = MAP_PRIVATE | MAP_ANONYMOUS;
+            if (policy_.populate && !bind)
+                flag |= MAP_POPULATE; // bound mappings are prefaulted after mbind
 
             mem_node *node = req_node_();
 
-            void *mem = ::mmap(nullptr, real_size, prot, flag, -1, 0);
+            void *mem = MAP_FAILED;
+            bool huge = false;
+
+            #ifdef MAP_HUGETLB
+            if (policy_.huge_tlb && need_size >= MEM_HUGE_PAGE_SIZE) {
+                const std::size_t huge_size = round_(need_size, MEM_HUGE_PAGE_SIZE);
+                mem = ::mmap(nullptr, huge_size, prot, flag | MAP_HUGETLB, -1, 0);
+                if (mem != MAP_FAILED) {
+                    real_size = huge_size;
+                    huge      = true;
+                }
+            }
+            #endif
+
+            if (mem == MAP_FAILED)
+                mem = ::mmap(nullptr, real_size, prot, flag, -1, 0);
 
             if (mem == MAP_FAILED)
                 abort_("mmap page allocation failed [MAP_FAILED]");
 
-            const int advice = MADV_WILLNEED | ( real_size >= (2 * 1024 * 1024) ? MADV_HUGEPAGE : 0);
-            ::madvise(mem, real_size, advice);
+            // advice values are not flags, every one is a separate call
+            if (!huge && policy_.huge_advice && real_size >= MEM_HUGE_PAGE_SIZE)
+                ::madvise(mem, real_size, MADV_HUGEPAGE);
+            if (!policy_.populate)
+                ::madvise(mem, real_size, MADV_WILLNEED);
+
+            if (bind) {
+                bind_(mem, real_size, policy_.numa_node);
+                if (policy_.populate)
+                    prefault_(mem, real_size);
+            }
 
             node->size = static_cast<int64_t>(real_size);
             node->data = mem;
+            node->link = nullptr;
 
-            *size_allocated = real_size;
+            table_put_(node);
+            mapped_b_ += node->size;
+
+            if (size_allocated != nullptr)
+                *size_allocated = real_size;
             return mem;
         }
 
+        /**
+         * Size of the live mapping starting at <b>ptr</b>, 0 when there is none
+         */
+        std::size_t mapping_size(const void *ptr) const {
+            const int64_t index = table_find_(ptr);
+            return index < 0 ? 0 : static_cast<std::size_t>(table_[index]->size);
+        }
+
+        /**
+         * Drops physical pages fully contained in [ptr, ptr + size), mapping stays valid
+         * and reads zero (or stale data with retain_lazy) afterwards. Returns bytes advised.
+         */
+        std::size_t punch(void *ptr, const std::size_t size) const {
+            const u_int64_t from = round_(reinterpret_cast<u_int64_t>(ptr), page_size);
+            const u_int64_t to   = (reinterpret_cast<u_int64_t>(ptr) + size) / page_size * page_size;
+            if (to <= from)
+                return 0;
+            decay_(reinterpret_cast<void *>(from), to - from);
+            return to - from;
+        }
+
         void release(void *ptr) {
             if (ptr == nullptr)
                 return;
-            mem_node *head = node_head;
-            while (head != nullptr) {
-                mem_node *prev = head->prev;
-                if (head->data == ptr) {
-                    if (head->size > 0 && head->data != nullptr) {
-                        if (const int err = ::munmap(head->data, head->size); err != 0)
-                            abort_("munmap deallocation error: " << err);
-                    }
-                    head->size = 0;
-                    head->data = nullptr;
-                    // release and create gap
-                    return;
-                }
-                head = prev;
+
+            const int64_t index = table_find_(ptr);
+            if (index < 0)
+                return;
+
+            mem_node *node = table_[index];
+            table_erase_(index);
+            mapped_b_ -= node->size;
+
+            if (retained_b_ + node->size <= static_cast<int64_t>(policy_.retain_b)) {
+                decay_(node->data, node->size);
+                node->link   = retained_;
+                retained_    = node;
+                retained_b_ += node->size;
+                return;
+            }
+
+            if (const int err = ::munmap(node->data, node->size); err != 0)
+                abort_("munmap deallocation error: " << err);
+
+            node->size = 0;
+            node->data = nullptr;
+            node->link = spare_;
+            spare_     = node;
+        }
+
+        /**
+         * Retained mapping of at least <b>size</b> bytes, but not wasting more than the size itself
+         */
+        mem_node *retained_take_(const std::size_t size) {
+            for (mem_node *node = retained_, *prev = nullptr; node != nullptr; prev = node, node = node->link) {
+                const std::size_t have = static_cast<std::size_t>(node->size);
+                if (have < size || have > 2 * size)
+                    continue;
+
+                if (prev != nullptr)
+                    prev->link = node->link;
+                else
+                    retained_ = node->link;
+
+                node->link   = nullptr;
+                retained_b_ -= node->size;
+                return node;
+            }
+            return nullptr;
+        }
+
+        void decay_(void *mem, const std::size_t size) const {
+            #ifdef MADV_FREE
+            if (policy_.retain_lazy && ::madvise(mem, size, MADV_FREE) == 0)
+                return;
+            #endif
+            ::madvise(mem, size, MADV_DONTNEED);
+        }
+
+        void table_put_(mem_node *node) {
+            if (2 * (table_n_ + 1) > table_cap_)
+                table_grow_();
+
+            const int64_t mask = table_cap_ - 1;
+            int64_t       i    = hash_(node->data) & mask;
+            while (table_[i] != nullptr)
+                i = (i + 1) & mask;
+
+            table_[i] = node;
+            table_n_++;
+        }
+
+        int64_t table_find_(const void *ptr) const {
+            if (table_ == nullptr)
+                return -1;
+
+            const int64_t mask = table_cap_ - 1;
+            for (int64_t i = hash_(ptr) & mask; table_[i] != nullptr; i = (i + 1) & mask) {
+                if (table_[i]->data == ptr)
+                    return i;
+            }
+            return -1;
+        }
+
+        /**
+         * Backward shift deletion, no tombstones
+         */
+        void table_erase_(int64_t i) {
+            const int64_t mask = table_cap_ - 1;
+            for (int64_t j = (i + 1) & mask; table_[j] != nullptr; j = (j + 1) & mask) {
+                const int64_t home = hash_(table_[j]->data) & mask;
+                // entry stays if its home slot lies cyclically in (i, j]
+                if (i <= j ? (home > i && home <= j) : (home > i || home <= j))
+                    continue;
+                table_[i] = table_[j];
+                i         = j;
+            }
+            table_[i] = nullptr;
+            table_n_--;
+        }
+
+        void table_grow_() {
+            mem_node    **old_table = table_;
+            const int64_t old_cap   = table_cap_;
+
+            table_cap_ = old_cap == 0 ? static_cast<int64_t>(page_size / sizeof(mem_node *)) : 2 * old_cap;
+            table_n_   = 0;
+
+            void *mem = ::mmap(nullptr, table_cap_ * sizeof(mem_node *), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (mem == MAP_FAILED)
+                abort_("mmap page allocation failed [MAP_FAILED]");
+            table_ = static_cast<mem_node **>(mem);
+
+            if (old_table == nullptr)
+                return;
+
+            for (int64_t i = 0; i < old_cap; ++i) {
+                if (old_table[i] != nullptr)
+                    table_put_(old_table[i]);
             }
+
+            if (const int err = ::munmap(old_table, old_cap * sizeof(mem_node *)); err != 0)
+                abort_("munmap deallocation error: " << err);
+        }
+
+        static int64_t hash_(const void *ptr) {
+            // mappings are page aligned, low bits carry nothing
+            const u_int64_t h = (reinterpret_cast<u_int64_t>(ptr) >> 12) * 0x9E3779B97F4A7C15ULL;
+            return static_cast<int64_t>(h >> 32);
         }
 
         mem_node *req_node_() {
+            if (spare_ != nullptr) {
+                mem_node *node = spare_;
+                spare_     = node->link;
+                node->link = nullptr;
+                return node;
+            }
+
             if (node_head == nullptr || node_num_ <= 0 || node_ctr_ >= node_num_) {
                 constexpr int prot = PROT_READ | PROT_WRITE;
                 constexpr int flag = MAP_PRIVATE | MAP_ANONYMOUS;
@@ -163,6 +442,34 @@ namespace ex::data {
             return node_head;
         }
 
+        void prefault_(void *mem, const std::size_t size) const {
+            volatile unsigned char *ptr = static_cast<unsigned char *>(mem);
+            for (std::size_t i = 0; i < size; i += page_size)
+                ptr[i] = 0;
+        }
+
+        static void bind_(void *mem, const std::size_t size, const int numa_node) {
+            #ifdef SYS_mbind
+            constexpr int MPOL_BIND_  = 2;
+            constexpr int MPOL_LOCAL_ = 4;
+
+            if (numa_node == MEM_NUMA_LOCAL) {
+                ::syscall(SYS_mbind, mem, size, MPOL_LOCAL_, nullptr, 0, 0);
+                return;
+            }
+
+            if (numa_node < 0 || numa_node >= 64)
+                abort_("NUMA node out of range: " << numa_node);
+
+            const unsigned long mask = 1UL << numa_node;
+            ::syscall(SYS_mbind, mem, size, MPOL_BIND_, &mask, sizeof(mask) * 8, 0); // no NUMA, no binding
+            #endif
+        }
+
+        static std::size_t round_(const std::size_t size, const std::size_t unit) {
+            return (size % unit != 0) ? (size - (size % unit) + unit) : size;
+        }
+
         static u_int32_t padding_(const void *ptr, const u_int64_t alignment_b) {
             const u_int64_t address = reinterpret_cast<u_int64_t>(ptr);
             return (alignment_b - (address % alignment_b)) % alignment_b;
@@ -188,7 +495,8 @@ namespace ex::data {
 
         mem_node *node = nullptr;
 
-        mem_provider() = default;
+        mem_provider(const mem_policy & = mem_policy::standard()) {
+        }
 
         ~mem_provider() {
             if (node == nullptr)
@@ -254,6 +562,18 @@ namespace ex::data {
             return mem;
         }
 
+        std::size_t mapping_size(const void *ptr) const {
+            for (const mem_node *head = node; head != nullptr; head = head->prev) {
+                if (head->data == ptr)
+                    return static_cast<std::size_t>(head->size);
+            }
+            return 0;
+        }
+
+        std::size_t punch(void *, std::size_t) const {
+            return 0;
+        }
+
         void release(void *ptr) {
             mem_node *head = node;
             mem_node *next = nullptr;
@@ -263,6 +583,8 @@ namespace ex::data {
                     ::free(head->data);
                     if (next != nullptr)
                         next->prev = prev;
+                    else
+                        node = prev;
                     ::free(head);
                     return;
                 }
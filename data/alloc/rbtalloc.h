@@ -6,7 +6,9 @@
 #define EX_LIMBO_DATA_RBTALLOC_H
 
 #include "../struct/rmq_map.h"
+#include "../struct/flat_rmq_map.h"
 #include "stackarena.h"
+#include <type_traits>
 
 namespace ex::data::rbtalloc {
 
@@ -19,16 +21,45 @@ namespace ex::data::rbtalloc {
         u_int32_t size_b;
         u_int16_t alignment_b;
         u_int8_t  is_free;
+        u_int8_t  scavenged; // pages of the free block already handed back
     };
 
     using block_addr_t = void *;
     using block_free_t = u_int32_t;
     using block_map_t  = rmq_map<block_addr_t, memory_block, block_free_t>;
+    using flat_map_t   = flat_rmq_map<block_addr_t, memory_block, block_free_t>;
 
 #define BLOCK_MAX_SIZE_B (4294967295U)
-#define STACK_BLOCK_SIZE (sizeof(block_map_t::rmq_node))
 
-    struct allocator {
+    /**
+     * Which free block serves a request
+     */
+    enum class fit_policy : u_int8_t {
+        first,   // first fitting block met top-down in the index, cheapest lookup
+        address, // fitting block with the lowest address, keeps the heap packed towards its start
+        best,    // smallest fitting block (lowest address on ties), least splitting of large blocks
+    };
+
+#ifndef RBTALLOC_FIT
+#define RBTALLOC_FIT (fit_policy::first)
+#endif
+
+// #define RBTALLOC_AGGRESSIVE // free_sized() trusts the size given, no block lookup and no cross-check
+
+    /**
+     * <b>map_t</b> is the block index: the pointer tree (rmq_map, nodes from a stack arena)
+     * or the compact one (flat_rmq_map, 32-bit links in a single cache-line aligned array)
+     */
+    template <typename map_t>
+    struct basic_allocator {
+
+        using block_map_t = map_t;
+        using rmq_node    = typename map_t::rmq_node;
+
+        static constexpr bool flat_ = requires (const map_t &map) { map.size_bytes(); };
+
+        struct no_arena_ {};
+        using arena_t = std::conditional_t<flat_, no_arena_, ex::data::stackarena::allocator>;
 
         static int32_t ptr_compare(const block_addr_t *a, const block_addr_t *b) {
             const u_int64_t aa = reinterpret_cast<u_int64_t>(*a);
@@ -36,43 +67,51 @@ namespace ex::data::rbtalloc {
             return (aa > bb) - (aa < bb);
         }
 
-        ex::data::stackarena::allocator arena_ = {
-            STACK_BLOCK_SIZE,
-            STACK_ARENA_SIZE
-        };
+        [[no_unique_address]] arena_t arena_ = arena_make_();
 
-        block_map_t  blocks_ = { arena_.compat(), &ptr_compare };
+        block_map_t  blocks_ = { nodes_allocator_(), &ptr_compare };
         mem_provider memory_;
 
         std::size_t used_mem_ = 0;
         std::size_t def_size_ = 0;
         std::size_t grow_mem_ = 0;
+        fit_policy  fit_      = RBTALLOC_FIT;
+
+        scavenge_stats scavenged_   = {};
+        block_addr_t   scavenge_at_ = nullptr; // next block to visit
+
+        alloc_stats_(alloc_stats stats_;)
 
         ex::data::allocator compat() {
-            return alloc_compat<allocator>::allocator(this);
+            return alloc_compat<basic_allocator>::allocator(this);
         }
 
-        allocator(const std::size_t pre_allocated = ALLOC_DEF_SIZE_B) {
+        basic_allocator(const std::size_t pre_allocated = ALLOC_DEF_SIZE_B, const mem_policy &policy = mem_policy::standard(),
+                        const fit_policy fit = RBTALLOC_FIT) :
+            memory_(policy), fit_(fit) {
             preallocate(pre_allocated);
         }
 
-        allocator(const allocator &other) = delete;
-        allocator(allocator &&other)      = delete;
+        basic_allocator(const basic_allocator &other) = delete;
+        basic_allocator(basic_allocator &&other)      = delete;
 
-        allocator &operator = (const allocator &other) = delete;
-        allocator &operator = (allocator &&other)      = delete;
+        basic_allocator &operator = (const basic_allocator &other) = delete;
+        basic_allocator &operator = (basic_allocator &&other)      = delete;
 
-        ~allocator() {
+        ~basic_allocator() {
             blocks_.clean();
             memory_.clean();
-            arena_.clean();
+            arena_clean_();
         }
 
         void clean() {
             blocks_.clean();
             memory_.clean();
-            arena_.clean();
-            used_mem_ = 0;
+            arena_clean_();
+            used_mem_    = 0;
+            scavenged_   = {};
+            scavenge_at_ = nullptr;
+            alloc_stats_(stats_.reset());
         }
 
         void preallocate(const std::size_t pre_allocated = ALLOC_DEF_SIZE_B) {
@@ -83,7 +122,9 @@ namespace ex::data::rbtalloc {
             const block_addr_t allocated_ptr  = memory_.request(pre_allocated, &allocated_size);
 
             const auto size_b = static_cast<block_free_t>(allocated_size);
-            blocks_.put(allocated_ptr, { size_b, 1, true }, size_b);
+            blocks_.put(allocated_ptr, { size_b, 1, true, 0 }, size_b);
+            alloc_stats_(stats_.on_block_free(size_b));
+            alloc_stats_(stats_.on_largest(largest_free_()));
             def_size_ = pre_allocated;
             grow_mem_ = pre_allocated;
 
@@ -93,11 +134,15 @@ namespace ex::data::rbtalloc {
         block_addr_t malloc(const std::size_t size_b, const std::size_t alignment_b) {
             if (size_b == 0)
                 abort_("Empty memory block allocation");
-            if (const block_addr_t allocated = block_acquire_(size_b, alignment_b))
+            if (const block_addr_t allocated = block_acquire_(size_b, alignment_b)) {
+                alloc_stats_(stats_.on_malloc(size_b));
                 return allocated;
+            }
             block_request_(size_b + alignment_b);
-            if (const block_addr_t allocated = block_acquire_(size_b, alignment_b))
+            if (const block_addr_t allocated = block_acquire_(size_b, alignment_b)) {
+                alloc_stats_(stats_.on_malloc(size_b));
                 return allocated;
+            }
             abort_("Out of free space");
         }
 
@@ -116,37 +161,25 @@ namespace ex::data::rbtalloc {
 
             if (size_new_b < block.size_b) {
                 const std::size_t  size_d  = block.size_b - size_new_b;
-                const memory_block block_l = { static_cast<u_int32_t>(size_new_b), block.alignment_b, 0 };
-                const memory_block block_r = { static_cast<u_int32_t>(size_d), 1, 0 };
+                const memory_block block_l = { static_cast<u_int32_t>(size_new_b), block.alignment_b, 0, 0 };
+                const memory_block block_r = { static_cast<u_int32_t>(size_d), 1, 0, 0 };
                 const block_addr_t ptr_r   = static_cast<unsigned char *>(ptr) + size_new_b;
                 blocks_.put(ptr, block_l, 0);
                 blocks_.put(ptr_r, block_r, 0);
+                alloc_stats_(stats_.on_realloc(block.size_b, size_new_b));
                 block_free_(ptr_r, block_r);
 
 //                verify_rb_tree_(blocks_);
                 return ptr;
             }
 
-            if (block_map_t::rmq_node *next = blocks_.next(ptr);
-                continuous_(ptr, next, block.size_b)) {
-                const std::size_t  size_d  = size_new_b - block.size_b;
-                const memory_block block_n = next->val;
-                const memory_block block_l = { static_cast<u_int32_t>(size_new_b), block.alignment_b, 0 };
-                const memory_block block_r = { static_cast<u_int32_t>(block_n.size_b - size_d), 1, 1 };
-                const block_addr_t ptr_r   = static_cast<unsigned char *>(ptr) + size_new_b;
-                const block_addr_t ptr_n   = next->key;
-                blocks_.remove(ptr_n);
-                blocks_.put(ptr, block_l, 0);
-                blocks_.put(ptr_r, block_r, block_r.size_b);
-                used_mem_ -= size_d;
-
-//                verify_rb_tree_(blocks_);
+            if (block_expand_(ptr, block, size_new_b))
                 return ptr;
-            }
 
             const block_addr_t allocated = malloc(size_new_b, block.alignment_b);
             if (allocated != ptr) {
                 ::memmove(allocated, ptr, size_new_b < block.size_b ? size_new_b : block.size_b);
+                alloc_stats_(stats_.on_free(block.size_b));
                 block_free_(ptr, block);
 
 //                verify_rb_tree_(blocks_);
@@ -162,15 +195,51 @@ namespace ex::data::rbtalloc {
             if (ptr == nullptr)
                 return;
             const memory_block block = blocks_.at(ptr);
+            alloc_stats_(stats_.on_free(block.size_b));
+            block_free_(ptr, block);
+        }
+
+        /**
+         * <b>size_b</b> must be the size the block was allocated (or last resized) with.
+         * It is cross-checked against the index (so unknown pointers and double frees still abort),
+         * with RBTALLOC_AGGRESSIVE the lookup is skipped and a wrong size <b>silently corrupts the heap</b>
+         */
+        void free_sized(const block_addr_t ptr, const std::size_t size_b, const std::size_t alignment_b) {
+            if (ptr == nullptr)
+                return;
+            #ifndef RBTALLOC_AGGRESSIVE
+            static_cast<void>(alignment_b);
+            const memory_block block = blocks_.at(ptr);
+            if (block.size_b != size_b)
+                abort_("Sized free of a block with a different size");
+            #else
+            const memory_block block = { static_cast<u_int32_t>(size_b), static_cast<u_int16_t>(alignment_b), 0, 0 };
+            #endif
+            alloc_stats_(stats_.on_free(block.size_b));
             block_free_(ptr, block);
         }
 
+        /**
+         * Grows the block in place (no copy, pointer stays valid), false if the free neighbour is missing or too small.
+         * Smaller sizes shrink it as realloc does, so the recorded size always matches what free_sized() gets later
+         */
+        bool try_expand(void *ptr, const std::size_t size_new_b) {
+            if (ptr == nullptr)
+                return false;
+            const memory_block block = blocks_.at(ptr);
+            if (block.is_free == true)
+                abort_("Expansion of free block");
+            if (size_new_b <= block.size_b)
+                return size_new_b > 0 && realloc(ptr, size_new_b) == ptr;
+            return block_expand_(ptr, block, size_new_b);
+        }
+
         long size_used() const {
-            return used_mem_ + arena_.size_used();
+            return used_mem_ + meta_used_();
         }
 
         long size_total() const {
-            return memory_.size() + arena_.size_total();
+            return memory_.size() + meta_total_();
         }
 
         long blocks_total() const {
@@ -185,6 +254,59 @@ namespace ex::data::rbtalloc {
             return c;
         }
 
+        /**
+         * Hands pages of large free blocks back to the OS, walking blocks in address order
+         * and resuming where the previous call stopped. Blocks covering a whole region are unmapped,
+         * others are punched (MADV_DONTNEED/MADV_FREE).
+         * @return bytes released by this call
+         */
+        std::size_t scavenge(const scavenge_budget &budget = {}) {
+            const auto  start    = std::chrono::steady_clock::now();
+            std::size_t released = 0;
+            scavenged_.calls++;
+
+            block_addr_t key = (scavenge_at_ != nullptr && blocks_.contains(scavenge_at_)) ? scavenge_at_ : nullptr;
+            for (int64_t n = blocks_.size(); n > 0; --n) {
+                if (released >= budget.bytes || std::chrono::steady_clock::now() - start >= budget.time)
+                    break;
+
+                if (key == nullptr) {
+                    const rmq_node *first = blocks_.first();
+                    if (first == nullptr)
+                        break;
+                    key = first->key;
+                }
+
+                const rmq_node *next     = blocks_.next(key);
+                const block_addr_t           next_key = next != nullptr ? next->key : nullptr;
+
+                if (memory_block &block = blocks_.at(key); block.is_free && !block.scavenged && block.size_b >= budget.min_span_b)
+                    released += block_scavenge_(key, block);
+
+                key = next_key;
+            }
+
+            scavenge_at_ = key;
+            return released;
+        }
+
+        const scavenge_stats &scavenged() const {
+            return scavenged_;
+        }
+
+        /**
+         * Lock-free, may be called from any thread, false when compiled without ALLOC_STATS
+         */
+        bool stats_snapshot(alloc_stats_snapshot *out) const {
+            #ifdef ALLOC_STATS
+            stats_.snapshot(out);
+            return true;
+            #else
+            (void) out;
+            return false;
+            #endif
+        }
+
         // =========================================== INTERNAL UTILS ==================================================
 
         /**
@@ -196,7 +318,7 @@ namespace ex::data::rbtalloc {
             if (min_size_b > BLOCK_MAX_SIZE_B)
                 abort_("Requested allocation size overflow");
 
-            block_map_t::rmq_node *last = blocks_.last();
+            rmq_node *last = blocks_.last();
             if (last == nullptr) {
                 preallocate(def_size_);
                 last = blocks_.last();
@@ -215,16 +337,71 @@ namespace ex::data::rbtalloc {
             if (continuous_(last_ptr, allocated_ptr, last_block.size_b)) {
                 // extend last free block which belongs to the same memory region
                 if (last_block.is_free == true) {
-                    last->val.size_b += allocated_size;
+                    last->val.size_b   += allocated_size;
+                    last->val.scavenged = 0; // the merged span has fresh pages, scavenge() has to see it again
                     last->rmq = last->val.size_b;
                     blocks_.update_ranges_(last);
+                    alloc_stats_(stats_.on_block_taken(last_block.size_b));
+                    alloc_stats_(stats_.on_block_free(last->val.size_b));
+                    alloc_stats_(stats_.on_largest(largest_free_()));
                     return;
                 }
             }
 
             // append new free block
             const auto size_b = static_cast<block_free_t>(allocated_size);
-            blocks_.put(allocated_ptr, { size_b, 1, true }, size_b);
+            blocks_.put(allocated_ptr, { size_b, 1, true, 0 }, size_b);
+            alloc_stats_(stats_.on_block_free(size_b));
+            alloc_stats_(stats_.on_largest(largest_free_()));
+        }
+
+        /**
+         * Takes the head of the next free block if it is adjacent and big enough
+         */
+        bool block_expand_(void *ptr, const memory_block &block, const std::size_t size_new_b) {
+            rmq_node *next = blocks_.next(ptr);
+            if (next == nullptr || next->val.is_free != true || !continuous_(ptr, next->key, block.size_b))
+                return false;
+
+            const std::size_t size_d = size_new_b - block.size_b;
+            if (next->val.size_b < size_d)
+                return false;
+
+            const memory_block block_n = next->val;
+            const memory_block block_l = { static_cast<u_int32_t>(size_new_b), block.alignment_b, 0, 0 };
+            const memory_block block_r = { static_cast<u_int32_t>(block_n.size_b - size_d), 1, 1, block_n.scavenged };
+            const block_addr_t ptr_r   = static_cast<unsigned char *>(ptr) + size_new_b;
+            blocks_.remove(next->key);
+            blocks_.put(ptr, block_l, 0);
+            if (block_r.size_b > 0)
+                blocks_.put(ptr_r, block_r, block_r.size_b);
+            used_mem_ += size_d;
+
+            alloc_stats_(stats_.on_block_taken(block_n.size_b));
+            alloc_stats_(if (block_r.size_b > 0) stats_.on_block_free(block_r.size_b));
+            alloc_stats_(stats_.on_largest(largest_free_()));
+            alloc_stats_(stats_.on_realloc(block.size_b, size_new_b));
+            return true;
+        }
+
+        std::size_t block_scavenge_(const block_addr_t key, memory_block &block) {
+            if (const std::size_t mapping = memory_.mapping_size(key); mapping > 0 && mapping == block.size_b) {
+                // the only block of the region
+                blocks_.remove(key);
+                memory_.release(key);
+                alloc_stats_(stats_.on_block_taken(mapping));
+                alloc_stats_(stats_.on_largest(largest_free_()));
+
+                grow_mem_ = grow_mem_ > mapping + def_size_ ? grow_mem_ - mapping : def_size_;
+                scavenged_.unmapped_b += mapping;
+                scavenged_.regions_n++;
+                return mapping;
+            }
+
+            const std::size_t punched = memory_.punch(key, block.size_b);
+            block.scavenged = 1;
+            scavenged_.released_b += punched;
+            return punched;
         }
 
         block_addr_t block_acquire_(const std::size_t size_b, const std::size_t alignment_b) {
@@ -235,8 +412,8 @@ namespace ex::data::rbtalloc {
             if (alignment_b == 0 || (alignment_b & (alignment_b - 1)) != 0)
                 abort_("Alignment must be non-zero and a power of two");
 
-            memory_block test_that           = { static_cast<u_int32_t>(size_b), static_cast<u_int16_t>(alignment_b) };
-            const block_map_t::rmq_node *fit = blocks_.range_fit(size_b, BLOCK_MAX_SIZE_B, &test_padding_, &test_that);
+            memory_block test_that           = { static_cast<u_int32_t>(size_b), static_cast<u_int16_t>(alignment_b), 0, 0 };
+            const rmq_node *fit = block_fit_(size_b, &test_that);
             if (fit == nullptr)
                 return nullptr;
 
@@ -248,13 +425,13 @@ namespace ex::data::rbtalloc {
             const u_int32_t size_rs = fit_block.size_b - size_ls - padding;
 
             const block_addr_t l_ptr   = static_cast<unsigned char *>(fit_key) + padding;
-            const memory_block l_block = { size_ls, static_cast<u_int16_t>(alignment_b), 0 };
+            const memory_block l_block = { size_ls, static_cast<u_int16_t>(alignment_b), 0, 0 };
             blocks_.put(l_ptr, l_block, 0);
 
 //            verify_rb_tree_(blocks_);
 
             if (padding > 0) {
-                const memory_block f_block = { padding, 1, 1 };
+                const memory_block f_block = { padding, 1, 1, 0 };
                 blocks_.put(fit_key, f_block, padding);
 
 //                verify_rb_tree_(blocks_);
@@ -262,13 +439,17 @@ namespace ex::data::rbtalloc {
 
             if (size_rs > 0) {
                 const block_addr_t r_ptr   = static_cast<unsigned char *>(l_ptr) + size_ls;
-                const memory_block r_block = { size_rs, 1, 1 };
+                const memory_block r_block = { size_rs, 1, 1, 0 };
                 blocks_.put(r_ptr, r_block, size_rs);
 
 //                verify_rb_tree_(blocks_);
             }
 
             used_mem_ += size_ls;
+            alloc_stats_(stats_.on_block_taken(fit_block.size_b));
+            alloc_stats_(if (padding > 0) stats_.on_block_free(padding));
+            alloc_stats_(if (size_rs > 0) stats_.on_block_free(size_rs));
+            alloc_stats_(stats_.on_largest(largest_free_()));
             return l_ptr;
         }
 
@@ -278,11 +459,11 @@ namespace ex::data::rbtalloc {
 
             used_mem_ -= block.size_b;
 
-            memory_block free_block = { block.size_b, 1, 1 };
+            memory_block free_block = { block.size_b, 1, 1, 0 };
             block_addr_t free_ptr   = ptr;
 
-            const block_map_t::rmq_node *next = blocks_.next(ptr);
-            const block_map_t::rmq_node *prev = blocks_.prev(ptr);
+            const rmq_node *next = blocks_.next(ptr);
+            const rmq_node *prev = blocks_.prev(ptr);
 
             block_addr_t prev_key = nullptr;
             block_addr_t next_key = nullptr;
@@ -292,6 +473,7 @@ namespace ex::data::rbtalloc {
                     // merging next block which belongs to the same memory region
                     free_block.size_b += next->val.size_b;
                     next_key = next->key;
+                    alloc_stats_(stats_.on_block_taken(next->val.size_b));
                 }
             }
 
@@ -300,6 +482,7 @@ namespace ex::data::rbtalloc {
                     // merging prev block which belongs to the same memory region
                     free_block.size_b += prev->val.size_b;
                     prev_key = prev->key;
+                    alloc_stats_(stats_.on_block_taken(prev->val.size_b));
                     free_ptr = prev->key;
                 }
             }
@@ -316,10 +499,13 @@ namespace ex::data::rbtalloc {
 
             blocks_.put(free_ptr, free_block, free_block.size_b);
 //            verify_rb_tree_(blocks_);
+
+            alloc_stats_(stats_.on_block_free(free_block.size_b));
+            alloc_stats_(stats_.on_largest(largest_free_()));
         }
 
         void safe_remove_(void *ptr) {
-//            block_map_t::rmq_node *replacement =
+//            rmq_node *replacement =
                 blocks_.remove(ptr);
 //            verify_rb_tree_(blocks_);
 //            if (replacement != nullptr) {
@@ -329,13 +515,62 @@ namespace ex::data::rbtalloc {
 //            }
         }
 
+        u_int64_t largest_free_() const {
+            const rmq_node *node = blocks_.range_max();
+            return node != nullptr ? node->rmq : 0;
+        }
+
+        static arena_t arena_make_() {
+            if constexpr (flat_)
+                return {};
+            else
+                return arena_t(sizeof(rmq_node), STACK_ARENA_SIZE);
+        }
+
+        ex::data::allocator nodes_allocator_() {
+            if constexpr (flat_)
+                return {};
+            else
+                return arena_.compat();
+        }
+
+        void arena_clean_() {
+            if constexpr (!flat_)
+                arena_.clean();
+        }
+
+        long meta_used_() const {
+            if constexpr (flat_)
+                return static_cast<long>(blocks_.size_bytes());
+            else
+                return arena_.size_used();
+        }
+
+        long meta_total_() const {
+            if constexpr (flat_)
+                return static_cast<long>(blocks_.size_bytes());
+            else
+                return arena_.size_total();
+        }
+
+        const rmq_node *block_fit_(const std::size_t size_b, memory_block *test_that) const {
+            switch (fit_) {
+                case fit_policy::address:
+                    return blocks_.range_fit_first(size_b, BLOCK_MAX_SIZE_B, &test_padding_, test_that);
+                case fit_policy::best:
+                    return blocks_.range_fit_best(size_b, BLOCK_MAX_SIZE_B, &test_padding_, test_that);
+                default:
+                    return blocks_.range_fit(size_b, BLOCK_MAX_SIZE_B, &test_padding_, test_that);
+            }
+        }
+
         static bool continuous_(void *prev, void *next, const u_int64_t prev_size) {
             if (next == nullptr || prev == nullptr)
                 return false;
             return (static_cast<unsigned char *>(prev) + prev_size) == next;
         }
 
-        static bool test_padding_(const block_map_t::rmq_node *node, void *this_) {
+        static bool test_padding_(const rmq_node *node, void *this_) {
             const memory_block *that_   = static_cast<memory_block *>(this_);
             const u_int64_t     padding = block_padding_(node->key, that_->alignment_b);
             return node->val.size_b >= (that_->size_b + padding);
@@ -353,7 +588,7 @@ namespace ex::data::rbtalloc {
 //                abort_("tree structure invalid");
 //        }
 //
-//        static bool verify_rmq_weights_(block_map_t::rmq_node *node, u_int32_t &min, u_int32_t &max) {
+//        static bool verify_rmq_weights_(rmq_node *node, u_int32_t &min, u_int32_t &max) {
 //            if (node == nullptr) return true;
 //
 //            u_int32_t min_l = node->rmq, max_l = node->rmq;
@@ -387,6 +622,9 @@ namespace ex::data::rbtalloc {
 //        }
     };
 
+    using allocator         = basic_allocator<block_map_t>;
+    using compact_allocator = basic_allocator<flat_map_t>;
+
 }
 
 #endif //EX_LIMBO_DATA_RBTALLOC_H
@@ -0,0 +1,329 @@
+//
+// Created by henryco on 17/10/26.
+//
+
+#ifndef EX_LIMBO_DATA_SLAB_H
+#define EX_LIMBO_DATA_SLAB_H
+
+#include "provider.h"
+#include "datalloc.h"
+#include <cstring>
+#include <cstdint>
+
+namespace ex::data::slab {
+
+// -----------------------------
+#ifndef SLAB_SPAN_SIZE
+#define SLAB_SPAN_SIZE  (64 KB)
+#endif
+
+#ifndef SLAB_CHUNK_SIZE
+#define SLAB_CHUNK_SIZE (1 MB)
+#endif
+// -----------------------------
+
+#define SLAB_CLASS_MIN   (3)     // 2^3 = 8b
+#define SLAB_CLASS_MAX   (12)    // 2^12 = 4kb
+#define SLAB_CLASS_NUM   (2 * (SLAB_CLASS_MAX - SLAB_CLASS_MIN) + 1)
+#define SLAB_LARGE       (SLAB_CLASS_NUM)
+
+    struct free_object {
+        free_object *next;
+    };
+
+    struct alignas(64) span_header {
+        span_header   *prev;
+        span_header   *next;
+        free_object   *free;       // released objects
+        unsigned char *bump;       // never used objects
+        unsigned char *end;
+        void          *base;       // mapping of a large object
+        u_int64_t      size_b;     // object size
+        u_int32_t      size_class;
+        u_int32_t      used;
+        bool           listed;
+    };
+
+    /**
+     * Size-class slab allocator.
+     * Objects up to 4kb are carved out of SLAB_SPAN_SIZE aligned spans, one size class per span,
+     * classes are laid on a geometric ladder (8, 12, 16, 24, 32, ..., 3072, 4096).
+     * Owning span (and so size class) is found by masking object address, objects carry no header.
+     * Bigger objects get a dedicated span aligned mapping.
+     */
+    struct allocator {
+
+        mem_provider memory_;
+
+        span_header *classes_[SLAB_CLASS_NUM] = {};
+        span_header *empty_                   = nullptr;
+
+        unsigned char *chunk_     = nullptr;
+        unsigned char *chunk_end_ = nullptr;
+
+        std::size_t used_mem_ = 0;
+
+        ex::data::allocator compat() {
+            return alloc_compat<allocator>::allocator(this);
+        }
+
+        allocator() = default;
+
+        allocator(const allocator &other) = delete;
+        allocator(allocator &&other)      = delete;
+
+        allocator &operator = (const allocator &other) = delete;
+        allocator &operator = (allocator &&other)      = delete;
+
+        ~allocator() {
+            memory_.clean();
+        }
+
+        void clean() {
+            memory_.clean();
+            for (int i = 0; i < SLAB_CLASS_NUM; ++i)
+                classes_[i] = nullptr;
+            empty_     = nullptr;
+            chunk_     = nullptr;
+            chunk_end_ = nullptr;
+            used_mem_  = 0;
+        }
+
+        void *malloc(const std::size_t size_b, const std::size_t alignment_b) {
+            if (size_b == 0)
+                abort_("Empty memory block allocation");
+            if (alignment_b == 0 || (alignment_b & (alignment_b - 1)) != 0)
+                abort_("Alignment must be non-zero and a power of two");
+
+            u_int32_t size_class = size_class_(size_b);
+            while (size_class < SLAB_CLASS_NUM && class_alignment_(size_class) < alignment_b)
+                size_class++;
+
+            if (size_class >= SLAB_CLASS_NUM)
+                return large_malloc_(size_b, alignment_b);
+
+            span_header *span = classes_[size_class];
+            if (span == nullptr)
+                span = span_acquire_(size_class);
+
+            void *ptr;
+            if (span->free != nullptr) {
+                ptr        = span->free;
+                span->free = next_of_(span->free);
+            } else {
+                ptr         = span->bump;
+                span->bump += span->size_b;
+            }
+
+            span->used++;
+            used_mem_ += span->size_b;
+
+            if (span->free == nullptr && span->bump + span->size_b > span->end)
+                span_unlist_(span); // full
+
+            return ptr;
+        }
+
+        void *realloc(void *ptr, const std::size_t size_new_b) {
+            if (size_new_b == 0 || ptr == nullptr) {
+                free(ptr);
+                return nullptr;
+            }
+
+            const span_header *span = span_of_(ptr);
+            if (size_new_b <= span->size_b)
+                return ptr;
+
+            const std::size_t alignment_b = span->size_class == SLAB_LARGE
+                ? static_cast<unsigned char *>(ptr) - reinterpret_cast<const unsigned char *>(span)
+                : class_alignment_(span->size_class);
+
+            void *allocated = malloc(size_new_b, alignment_b);
+            ::memcpy(allocated, ptr, span->size_b);
+            free(ptr);
+            return allocated;
+        }
+
+        void free(void *ptr) {
+            if (ptr == nullptr)
+                return;
+
+            span_header *span = span_of_(ptr);
+            used_mem_ -= span->size_b;
+
+            if (span->size_class == SLAB_LARGE) {
+                memory_.release(span->base);
+                return;
+            }
+
+            free_object *object = static_cast<free_object *>(ptr);
+            link_to_(object, span->free);
+            span->free = object;
+            span->used--;
+
+            if (span->used == 0) {
+                span_release_(span);
+                return;
+            }
+
+            if (!span->listed)
+                span_list_(span);
+        }
+
+        long size_used() const {
+            return static_cast<long>(used_mem_);
+        }
+
+        long size_total() const {
+            return memory_.size();
+        }
+
+        // =========================================== INTERNAL UTILS ==================================================
+
+        span_header *span_acquire_(const u_int32_t size_class) {
+            span_header *span = empty_;
+            if (span != nullptr) {
+                empty_ = span->next;
+            } else {
+                if (chunk_ == nullptr || chunk_ + SLAB_SPAN_SIZE > chunk_end_)
+                    chunk_request_();
+                span    = reinterpret_cast<span_header *>(chunk_);
+                chunk_ += SLAB_SPAN_SIZE;
+            }
+
+            const u_int32_t size_b = class_size_(size_class);
+            unsigned char  *data   = reinterpret_cast<unsigned char *>(span) + sizeof(span_header);
+
+            span->prev       = nullptr;
+            span->next       = nullptr;
+            span->free       = nullptr;
+            span->bump       = data + padding_(data, class_alignment_(size_class));
+            span->end        = reinterpret_cast<unsigned char *>(span) + SLAB_SPAN_SIZE;
+            span->base       = nullptr;
+            span->size_b     = size_b;
+            span->size_class = size_class;
+            span->used       = 0;
+            span->listed     = false;
+
+            span_list_(span);
+            return span;
+        }
+
+        /**
+         * Empty span goes back to the pool, unless it is the last one of its size class
+         */
+        void span_release_(span_header *span) {
+            if (span->listed && span->prev == nullptr && span->next == nullptr)
+                return;
+
+            if (span->listed)
+                span_unlist_(span);
+
+            span->next = empty_;
+            empty_     = span;
+        }
+
+        void span_list_(span_header *span) {
+            span_header *&head = classes_[span->size_class];
+            span->prev   = nullptr;
+            span->next   = head;
+            span->listed = true;
+            if (head != nullptr)
+                head->prev = span;
+            head = span;
+        }
+
+        void span_unlist_(span_header *span) {
+            if (span->prev != nullptr)
+                span->prev->next = span->next;
+            else
+                classes_[span->size_class] = span->next;
+
+            if (span->next != nullptr)
+                span->next->prev = span->prev;
+
+            span->prev   = nullptr;
+            span->next   = nullptr;
+            span->listed = false;
+        }
+
+        void chunk_request_() {
+            std::size_t allocated_size = 0;
+            void       *allocated_ptr  = memory_.request(SLAB_CHUNK_SIZE + SLAB_SPAN_SIZE, &allocated_size);
+
+            unsigned char *raw_ptr = static_cast<unsigned char *>(allocated_ptr);
+            chunk_     = raw_ptr + padding_(raw_ptr, SLAB_SPAN_SIZE);
+            chunk_end_ = raw_ptr + allocated_size;
+        }
+
+        void *large_malloc_(const std::size_t size_b, const std::size_t alignment_b) {
+            const std::size_t offset = alignment_b > sizeof(span_header) ? alignment_b : sizeof(span_header);
+            if (offset >= SLAB_SPAN_SIZE)
+                abort_("Alignment too big: " << alignment_b);
+
+            std::size_t allocated_size = 0;
+            void       *allocated_ptr  = memory_.request(size_b + offset + SLAB_SPAN_SIZE, &allocated_size);
+
+            unsigned char *raw_ptr = static_cast<unsigned char *>(allocated_ptr);
+            span_header   *span    = reinterpret_cast<span_header *>(raw_ptr + padding_(raw_ptr, SLAB_SPAN_SIZE));
+
+            *span = {};
+            span->base       = allocated_ptr;
+            span->size_b     = size_b;
+            span->size_class = SLAB_LARGE;
+
+            used_mem_ += size_b;
+            return reinterpret_cast<unsigned char *>(span) + offset;
+        }
+
+        /**
+         * Objects of the odd size classes are only 4b aligned, links are accessed bytewise
+         */
+        static free_object *next_of_(const free_object *object) {
+            free_object *next;
+            ::memcpy(&next, object, sizeof(free_object *));
+            return next;
+        }
+
+        static void link_to_(free_object *object, const free_object *next) {
+            ::memcpy(static_cast<void *>(object), &next, sizeof(free_object *));
+        }
+
+        static span_header *span_of_(void *ptr) {
+            const u_int64_t address = reinterpret_cast<u_int64_t>(ptr);
+            return reinterpret_cast<span_header *>(address & ~static_cast<u_int64_t>(SLAB_SPAN_SIZE - 1));
+        }
+
+        /**
+         * 8, 12, 16, 24, 32, 48, ... 2^n, 1.5 * 2^n, ... 4096
+         */
+        static u_int32_t size_class_(const std::size_t size_b) {
+            if (size_b <= (1U << SLAB_CLASS_MIN))
+                return 0;
+            if (size_b > (1U << SLAB_CLASS_MAX))
+                return SLAB_LARGE;
+            const u_int32_t size = static_cast<u_int32_t>(size_b - 1);
+            const u_int32_t p    = 31 - __builtin_clz(size);
+            const u_int32_t half = (1U << p) + (1U << (p - 1));
+            return 2 * (p - SLAB_CLASS_MIN) + (size_b <= half ? 1 : 2);
+        }
+
+        static constexpr u_int32_t class_size_(const u_int32_t size_class) {
+            const u_int32_t p = SLAB_CLASS_MIN + size_class / 2;
+            return (size_class % 2 == 0) ? (1U << p) : ((1U << p) + (1U << (p - 1)));
+        }
+
+        static constexpr u_int32_t class_alignment_(const u_int32_t size_class) {
+            const u_int32_t size_b = class_size_(size_class);
+            return size_b & (~size_b + 1);
+        }
+
+        static u_int32_t padding_(const void *ptr, const u_int64_t alignment_b) {
+            const u_int64_t address = reinterpret_cast<u_int64_t>(ptr);
+            return (alignment_b - (address % alignment_b)) % alignment_b;
+        }
+    };
+
+}
+
+#endif //EX_LIMBO_DATA_SLAB_H
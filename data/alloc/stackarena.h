@@ -9,9 +9,25 @@
 #include "datalloc.h"
 #include <cstring>
 #include <cstdint>
+#include <atomic>
+#include <mutex>
 
 namespace ex::data::stackarena {
 
+// -----------------------------
+#ifndef STACKARENA_BUMP_RUN
+#define STACKARENA_BUMP_RUN     (64)   // blocks claimed by a thread at once
+#endif
+
+#ifndef STACKARENA_BUMP_SLOTS
+#define STACKARENA_BUMP_SLOTS   (4)    // concurrent allocators a thread bumps from without re-claiming
+#endif
+
+#ifndef STACKARENA_REGIONS_MAX
+#define STACKARENA_REGIONS_MAX  (1024)
+#endif
+// -----------------------------
+
     template <std::size_t block_s, std::size_t arena_s, std::size_t stack_s = arena_s / block_s * sizeof(void *)>
     struct static_allocator {
 
@@ -112,6 +128,8 @@ namespace ex::data::stackarena {
         int64_t offset;
         int64_t free_n;
 
+        alloc_stats_(alloc_stats stats_;)
+
         ex::data::allocator compat() {
             return alloc_compat<allocator>::allocator(this);
         }
@@ -171,6 +189,7 @@ namespace ex::data::stackarena {
             offset     = 0;
             arena_     = root_a;
             stack_     = root_s;
+            alloc_stats_(stats_.reset());
         }
 
         void *realloc(void *, const std::size_t) {
@@ -196,11 +215,13 @@ namespace ex::data::stackarena {
                 }
 
                 taken_size += block_s;
+                alloc_stats_(stats_.on_malloc(block_s));
+                alloc_stats_(stats_.on_block_taken(block_s));
                 return out_ptr;
             }
 
         try_again:
-            if (offset >= arena_->size) {
+            if (offset + static_cast<int64_t>(block_s) > static_cast<int64_t>(arena_->size)) {
                 if (offset == 0)
                     abort_("offset == 0 yet no space");
                 offset = 0;
@@ -214,6 +235,7 @@ namespace ex::data::stackarena {
             void *ptr = arena_->data + offset;
             offset += block_s;
             taken_size += block_s;
+            alloc_stats_(stats_.on_malloc(block_s));
 
             return ptr;
         }
@@ -225,6 +247,7 @@ namespace ex::data::stackarena {
             if (static_cast<unsigned char *>(ptr) == (arena_->data + offset - block_s)) {
                 offset -= block_s;
                 taken_size -= block_s;
+                alloc_stats_(stats_.on_free(block_s));
                 return;
             }
 
@@ -248,6 +271,51 @@ namespace ex::data::stackarena {
 
             free_n += sizeof(void *);
             taken_size -= block_s;
+            alloc_stats_(stats_.on_free(block_s));
+            alloc_stats_(stats_.on_block_free(block_s));
+            alloc_stats_(stats_.on_largest(block_s));
+        }
+
+        /**
+         * Recycled blocks first, the rest is bumped off the arena a whole run at a time
+         */
+        void malloc_batch(const std::size_t n, std::size_t, std::size_t, void **out_ptrs) {
+            std::size_t i = 0;
+            while (i < n && free_n > 0)
+                out_ptrs[i++] = malloc(block_s, 1);
+
+            while (i < n) {
+                const int64_t fit_n = (static_cast<int64_t>(arena_->size) - offset) / static_cast<int64_t>(block_s);
+                if (fit_n <= 0) {
+                    out_ptrs[i++] = malloc(block_s, 1); // moves on to the next region
+                    continue;
+                }
+
+                const std::size_t run_n = (n - i) < static_cast<std::size_t>(fit_n) ? (n - i) : static_cast<std::size_t>(fit_n);
+                for (std::size_t k = 0; k < run_n; ++k) {
+                    out_ptrs[i++] = arena_->data + offset;
+                    offset += block_s;
+                    alloc_stats_(stats_.on_malloc(block_s));
+                }
+                taken_size += static_cast<int64_t>(run_n * block_s);
+            }
+        }
+
+        void free_batch(void *const *ptrs, const std::size_t n) {
+            for (std::size_t i = 0; i < n; ++i)
+                if (ptrs[i] != nullptr)
+                    free(ptrs[i]);
+        }
+
+        void free_sized(void *ptr, std::size_t, std::size_t) {
+            free(ptr);
+        }
+
+        /**
+         * Every block is block_s long, nothing to grow into
+         */
+        bool try_expand(void *ptr, const std::size_t size_new_b) const {
+            return ptr != nullptr && size_new_b <= block_s;
         }
 
         long size_total() const {
@@ -258,6 +326,20 @@ namespace ex::data::stackarena {
             return taken_size;
         }
 
+        /**
+         * Lock-free, may be called from any thread, false when compiled without ALLOC_STATS.
+         * Released blocks are all of block_s, so the largest free block is block_s once any was released.
+         */
+        bool stats_snapshot(alloc_stats_snapshot *out) const {
+            #ifdef ALLOC_STATS
+            stats_.snapshot(out);
+            return true;
+            #else
+            (void) out;
+            return false;
+            #endif
+        }
+
         void mem_request_() {
             std::size_t allocated_size = 0;
             void       *allocated_ptr  = memory_.request(sizeof(mem_region) + block_s + data_s, &allocated_size);
@@ -313,6 +395,304 @@ namespace ex::data::stackarena {
     };
 
 
+    struct bump_run {
+        u_int64_t owner; // allocator id, ids are never reused so stale runs are simply ignored
+        u_int32_t next;  // global block index
+        u_int32_t end;
+    };
+
+    inline std::atomic<u_int64_t> concurrent_ids_{ 1 };
+
+    inline thread_local bump_run  bump_runs_[STACKARENA_BUMP_SLOTS] = {};
+    inline thread_local u_int32_t bump_evict_                       = 0;
+
+    /**
+     * Thread-safe variant of the stack arena.
+     * Released blocks go to a Treiber stack, its head packs 32 bit ABA tag with 32 bit block index.
+     * Links are kept in a side table of atomics, so a racing pop never reads block (user) memory.
+     * Fresh blocks are bumped out of per-thread runs (STACKARENA_BUMP_RUN blocks each),
+     * runs are carved from size-aligned regions, so owning region is found by masking block address.
+     * Memory is returned to the OS only on destruction.
+     */
+    struct concurrent_allocator {
+
+        struct alignas(64) region_header {
+            u_int32_t               id;
+            unsigned char          *data;
+            std::atomic<u_int32_t> *links; // next free block index + 1, 0 terminates
+        };
+
+        const std::size_t block_s;
+        std::size_t       region_s;
+        u_int32_t         blocks_n; // per region, multiple of STACKARENA_BUMP_RUN
+
+        std::atomic<u_int64_t> id_;
+        std::atomic<u_int64_t> free_;   // [tag:32 | index + 1:32]
+        std::atomic<u_int64_t> cursor_; // next unclaimed run
+        std::atomic<int64_t>   taken_n_;
+
+        std::atomic<region_header *> regions_[STACKARENA_REGIONS_MAX] = {};
+        std::atomic<u_int32_t>       regions_n_;
+
+        mutable std::mutex memory_lock_;
+        mem_provider       memory_;
+
+        alloc_stats_(alloc_stats stats_;)
+
+        ex::data::allocator compat() {
+            return alloc_compat<concurrent_allocator>::allocator(this);
+        }
+
+        concurrent_allocator() = delete;
+
+        concurrent_allocator(const std::size_t block_size_b, const std::size_t arena_size_b) :
+            block_s(block_size_b),
+            id_(concurrent_ids_.fetch_add(1, std::memory_order_relaxed)),
+            free_(0),
+            cursor_(0),
+            taken_n_(0),
+            regions_n_(0) {
+            if (block_size_b == 0)
+                abort_("block_size_b cannot be 0");
+
+            const std::size_t min_s = sizeof(region_header) + STACKARENA_BUMP_RUN * (block_s + sizeof(u_int32_t)) + 64;
+            region_s = 1;
+            while (region_s < arena_size_b || region_s < min_s)
+                region_s <<= 1;
+
+            const std::size_t capacity = (region_s - sizeof(region_header) - 64) / (block_s + sizeof(u_int32_t));
+            blocks_n = static_cast<u_int32_t>(capacity / STACKARENA_BUMP_RUN * STACKARENA_BUMP_RUN);
+
+            region_request_(0);
+        }
+
+        concurrent_allocator(const concurrent_allocator &other) = delete;
+        concurrent_allocator(concurrent_allocator &&other)      = delete;
+
+        concurrent_allocator &operator = (const concurrent_allocator &other) = delete;
+        concurrent_allocator &operator = (concurrent_allocator &&other)      = delete;
+
+        ~concurrent_allocator() {
+            memory_.clean();
+        }
+
+        /**
+         * <b>Not thread-safe</b>, no other thread may use allocator during the call
+         */
+        void clean() {
+            id_.store(concurrent_ids_.fetch_add(1, std::memory_order_relaxed), std::memory_order_relaxed);
+            free_.store(0, std::memory_order_relaxed);
+            cursor_.store(0, std::memory_order_relaxed);
+            taken_n_.store(0, std::memory_order_relaxed);
+            alloc_stats_(stats_.reset());
+        }
+
+        void *realloc(void *, const std::size_t) {
+            abort_("Realloc not supported, this is arena bruh");
+        }
+
+        /**
+         * allocates only one block at a time
+         */
+        void *malloc(std::size_t, std::size_t) {
+            taken_n_.fetch_add(1, std::memory_order_relaxed);
+            alloc_stats_(stats_.on_malloc(block_s));
+
+            u_int64_t head = free_.load(std::memory_order_acquire);
+            while (index_of_(head) != 0) {
+                const u_int32_t index = index_of_(head) - 1;
+                const u_int32_t next  = link_(index).load(std::memory_order_relaxed);
+                if (free_.compare_exchange_weak(head, pack_(tag_of_(head) + 1, next),
+                                                std::memory_order_acquire, std::memory_order_acquire)) {
+                    alloc_stats_(stats_.on_block_taken(block_s));
+                    return block_(index);
+                }
+            }
+
+            bump_run *run = bump_run_();
+            if (run->next == run->end) {
+                const u_int64_t start = cursor_.fetch_add(STACKARENA_BUMP_RUN, std::memory_order_relaxed);
+                if (start + STACKARENA_BUMP_RUN > UINT32_MAX)
+                    abort_("out of block indexes");
+                region_request_(static_cast<u_int32_t>(start / blocks_n));
+                run->next = static_cast<u_int32_t>(start);
+                run->end  = static_cast<u_int32_t>(start + STACKARENA_BUMP_RUN);
+            }
+
+            return block_(run->next++);
+        }
+
+        /**
+         * releases block
+         */
+        void free(void *ptr) {
+            if (ptr == nullptr)
+                return;
+
+            const region_header *region = region_of_(ptr);
+            const u_int32_t      local  = local_of_(region, ptr);
+            const u_int32_t      index  = region->id * blocks_n + local;
+
+            std::atomic<u_int32_t> &link = region->links[local];
+            u_int64_t head = free_.load(std::memory_order_relaxed);
+            do {
+                link.store(index_of_(head), std::memory_order_relaxed);
+            } while (!free_.compare_exchange_weak(head, pack_(tag_of_(head) + 1, index + 1),
+                                                  std::memory_order_release, std::memory_order_relaxed));
+
+            taken_n_.fetch_sub(1, std::memory_order_relaxed);
+            alloc_stats_(stats_.on_free(block_s));
+            alloc_stats_(stats_.on_block_free(block_s));
+            alloc_stats_(stats_.on_largest(block_s));
+        }
+
+        void malloc_batch(const std::size_t n, std::size_t, std::size_t, void **out_ptrs) {
+            for (std::size_t i = 0; i < n; ++i)
+                out_ptrs[i] = malloc(block_s, 1);
+        }
+
+        void free_sized(void *ptr, std::size_t, std::size_t) {
+            free(ptr);
+        }
+
+        bool try_expand(void *ptr, const std::size_t size_new_b) const {
+            return ptr != nullptr && size_new_b <= block_s;
+        }
+
+        /**
+         * Links the blocks into a chain first, the whole chain is pushed with a single CAS
+         */
+        void free_batch(void *const *ptrs, const std::size_t n) {
+            std::atomic<u_int32_t> *tail  = nullptr;
+            u_int32_t               first = 0;
+            int64_t                 freed = 0;
+
+            for (std::size_t i = n; i-- > 0;) {
+                if (ptrs[i] == nullptr)
+                    continue;
+                const region_header *region = region_of_(ptrs[i]);
+                const u_int32_t      local  = local_of_(region, ptrs[i]);
+                if (tail == nullptr)
+                    tail = &region->links[local];
+                else
+                    region->links[local].store(first, std::memory_order_relaxed);
+                first = region->id * blocks_n + local + 1;
+                freed++;
+            }
+
+            if (tail == nullptr)
+                return;
+
+            u_int64_t head = free_.load(std::memory_order_relaxed);
+            do {
+                tail->store(index_of_(head), std::memory_order_relaxed);
+            } while (!free_.compare_exchange_weak(head, pack_(tag_of_(head) + 1, first),
+                                                  std::memory_order_release, std::memory_order_relaxed));
+
+            taken_n_.fetch_sub(freed, std::memory_order_relaxed);
+            alloc_stats_(for (int64_t i = 0; i < freed; ++i) stats_.on_free(block_s));
+            alloc_stats_(for (int64_t i = 0; i < freed; ++i) stats_.on_block_free(block_s));
+            alloc_stats_(stats_.on_largest(block_s));
+        }
+
+        long size_total() const {
+            std::lock_guard guard(memory_lock_);
+            return memory_.size();
+        }
+
+        long size_used() const {
+            return static_cast<long>(taken_n_.load(std::memory_order_relaxed) * static_cast<int64_t>(block_s));
+        }
+
+        /**
+         * Lock-free, may be called from any thread, false when compiled without ALLOC_STATS.
+         * Released blocks are all of block_s, so the largest free block is block_s once any was released.
+         */
+        bool stats_snapshot(alloc_stats_snapshot *out) const {
+            #ifdef ALLOC_STATS
+            stats_.snapshot(out);
+            return true;
+            #else
+            (void) out;
+            return false;
+            #endif
+        }
+
+        // =========================================== INTERNAL UTILS ==================================================
+
+        bump_run *bump_run_() {
+            const u_int64_t id = id_.load(std::memory_order_relaxed);
+            for (int i = 0; i < STACKARENA_BUMP_SLOTS; ++i) {
+                if (bump_runs_[i].owner == id)
+                    return &bump_runs_[i];
+            }
+            // remainder of the evicted run is lost
+            bump_run *run = &bump_runs_[bump_evict_++ % STACKARENA_BUMP_SLOTS];
+            *run = { id, 0, 0 };
+            return run;
+        }
+
+        void region_request_(const u_int32_t region_id) {
+            if (region_id < regions_n_.load(std::memory_order_acquire))
+                return;
+            if (region_id >= STACKARENA_REGIONS_MAX)
+                abort_("out of memory regions: " << region_id);
+
+            std::lock_guard guard(memory_lock_);
+            for (u_int32_t id = regions_n_.load(std::memory_order_relaxed); id <= region_id; ++id) {
+                std::size_t allocated_size = 0;
+                void       *allocated_ptr  = memory_.request(2 * region_s, &allocated_size);
+
+                unsigned char *raw_ptr = static_cast<unsigned char *>(allocated_ptr);
+                region_header *region  = reinterpret_cast<region_header *>(raw_ptr + padding_(raw_ptr, region_s));
+                unsigned char *links   = reinterpret_cast<unsigned char *>(region) + sizeof(region_header);
+                unsigned char *data    = links + blocks_n * sizeof(u_int32_t);
+
+                region->id    = id;
+                region->links = reinterpret_cast<std::atomic<u_int32_t> *>(links);
+                region->data  = data + padding_(data, 64);
+
+                regions_[id].store(region, std::memory_order_release);
+                regions_n_.store(id + 1, std::memory_order_release);
+            }
+        }
+
+        std::atomic<u_int32_t> &link_(const u_int32_t index) const {
+            return regions_[index / blocks_n].load(std::memory_order_acquire)->links[index % blocks_n];
+        }
+
+        void *block_(const u_int32_t index) const {
+            return regions_[index / blocks_n].load(std::memory_order_acquire)->data + (index % blocks_n) * block_s;
+        }
+
+        u_int32_t local_of_(const region_header *region, const void *ptr) const {
+            return static_cast<u_int32_t>((static_cast<const unsigned char *>(ptr) - region->data) / block_s);
+        }
+
+        region_header *region_of_(void *ptr) const {
+            const u_int64_t address = reinterpret_cast<u_int64_t>(ptr);
+            return reinterpret_cast<region_header *>(address & ~static_cast<u_int64_t>(region_s - 1));
+        }
+
+        static constexpr u_int64_t pack_(const u_int64_t tag, const u_int32_t index) {
+            return (tag << 32) | index;
+        }
+
+        static constexpr u_int32_t index_of_(const u_int64_t head) {
+            return static_cast<u_int32_t>(head);
+        }
+
+        static constexpr u_int64_t tag_of_(const u_int64_t head) {
+            return head >> 32;
+        }
+
+        static u_int32_t padding_(const void *ptr, const u_int64_t alignment_b) {
+            const u_int64_t address = reinterpret_cast<u_int64_t>(ptr);
+            return (alignment_b - (address % alignment_b)) % alignment_b;
+        }
+    };
+
+
 }
 
 #endif //EX_LIMBO_DATA_STACK_ARENA_H
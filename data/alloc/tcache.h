@@ -0,0 +1,365 @@
+//
+// Created by henryco on 17/10/26.
+//
+
+#ifndef EX_LIMBO_DATA_TCACHE_H
+#define EX_LIMBO_DATA_TCACHE_H
+
+#include "lalloc.h"
+#include <mutex>
+
+namespace ex::data::tcache {
+
+// -----------------------------
+#ifndef TCACHE_BATCH_SIZE
+#define TCACHE_BATCH_SIZE   (32)
+#endif
+
+#ifndef TCACHE_LOCAL_LIMIT
+#define TCACHE_LOCAL_LIMIT  (2 * TCACHE_BATCH_SIZE)
+#endif
+
+#ifndef TCACHE_SHARED_LIMIT
+#define TCACHE_SHARED_LIMIT (16 * TCACHE_BATCH_SIZE)
+#endif
+// -----------------------------
+
+#define TCACHE_CLASS_MIN (4)                  // 2^4 = 16b
+#define TCACHE_CLASS_NUM (8)                  // 16b .. 2kb
+#define TCACHE_LARGE     (TCACHE_CLASS_NUM)   // passthrough to the shared allocator
+
+    struct alignas(16) object_header {
+        u_int32_t size_class;
+        u_int32_t offset;     // distance from the shared allocator block to the object
+        u_int64_t size_b;     // usable object size
+    };
+
+    struct free_object {
+        free_object *next;
+    };
+
+    struct class_list {
+        free_object *head;
+        u_int32_t    size;
+    };
+
+    struct allocator;
+
+    struct thread_cache {
+        allocator    *owner;
+        thread_cache *next;      // caches of the same thread (one per allocator)
+        thread_cache *reg_prev;  // caches of the same allocator (one per thread)
+        thread_cache *reg_next;
+        class_list    lists[TCACHE_CLASS_NUM];
+    };
+
+    struct thread_caches {
+        thread_cache *head = nullptr;
+        ~thread_caches();
+    };
+
+    inline std::mutex &registry_lock_() {
+        static std::mutex lock;
+        return lock;
+    }
+
+    inline thread_local thread_caches local_caches_;
+
+    /**
+     * Thread-caching front end for lalloc::allocator.
+     * Small objects are served from per-thread free lists (one per size class),
+     * which are refilled from and spilled back to the shared allocator in batches.
+     * Objects are not owned by threads, so an object freed by another thread simply
+     * lands in the cache of the thread that frees it.
+     * <b> Allocator must outlive every thread that uses it. </b>
+     */
+    struct allocator {
+
+        lalloc::allocator  shared_;
+        mutable std::mutex lock_;
+        class_list         central_[TCACHE_CLASS_NUM] = {};
+        thread_cache      *caches_                    = nullptr;
+
+        ex::data::allocator compat() {
+            return alloc_compat<allocator>::allocator(this);
+        }
+
+        allocator(const std::size_t pre_allocated = ALLOC_DEF_SIZE_B, const std::size_t max_size = ALLOC_MAX_SIZE_B) :
+            shared_(pre_allocated, max_size) {
+        }
+
+        allocator(const allocator &other) = delete;
+        allocator(allocator &&other)      = delete;
+
+        allocator &operator = (const allocator &other) = delete;
+        allocator &operator = (allocator &&other)      = delete;
+
+        ~allocator() {
+            std::lock_guard guard(registry_lock_());
+            for (thread_cache *cache = caches_; cache != nullptr; cache = cache->reg_next) {
+                cache->owner = nullptr;
+                for (int i = 0; i < TCACHE_CLASS_NUM; ++i)
+                    cache->lists[i] = {};
+            }
+            caches_ = nullptr;
+        }
+
+        void clean() {
+            std::lock_guard registry(registry_lock_());
+            std::lock_guard guard(lock_);
+            for (thread_cache *cache = caches_; cache != nullptr; cache = cache->reg_next) {
+                for (int i = 0; i < TCACHE_CLASS_NUM; ++i)
+                    cache->lists[i] = {};
+            }
+            for (int i = 0; i < TCACHE_CLASS_NUM; ++i)
+                central_[i] = {};
+            shared_.clean();
+        }
+
+        void *malloc(const std::size_t size_b, const std::size_t alignment_b) {
+            if (size_b == 0)
+                abort_("Empty memory block allocation");
+
+            const u_int32_t size_class = size_class_(size_b);
+            if (size_class >= TCACHE_CLASS_NUM || alignment_b > sizeof(object_header))
+                return large_malloc_(size_b, alignment_b);
+
+            class_list &list = local_cache_()->lists[size_class];
+            if (list.head == nullptr)
+                refill_(list, size_class);
+
+            free_object *object = list.head;
+            list.head = object->next;
+            list.size--;
+            return object;
+        }
+
+        void *realloc(void *ptr, const std::size_t size_new_b) {
+            if (size_new_b == 0 || ptr == nullptr) {
+                free(ptr);
+                return nullptr;
+            }
+
+            const object_header header = *header_(ptr);
+            if (size_new_b <= header.size_b)
+                return ptr;
+
+            const std::size_t alignment_b = header.size_class == TCACHE_LARGE ? header.offset : 1;
+            void *allocated = malloc(size_new_b, alignment_b);
+            ::memcpy(allocated, ptr, header.size_b);
+            free(ptr);
+            return allocated;
+        }
+
+        void free(void *ptr) {
+            if (ptr == nullptr)
+                return;
+
+            const object_header *header = header_(ptr);
+            if (header->size_class >= TCACHE_CLASS_NUM) {
+                std::lock_guard guard(lock_);
+                shared_.free(static_cast<unsigned char *>(ptr) - header->offset);
+                return;
+            }
+
+            class_list  &list   = local_cache_()->lists[header->size_class];
+            free_object *object = static_cast<free_object *>(ptr);
+            object->next = list.head;
+            list.head    = object;
+            list.size++;
+
+            if (list.size > TCACHE_LOCAL_LIMIT)
+                spill_(list, header->size_class, TCACHE_BATCH_SIZE);
+        }
+
+        /**
+         * Returns every object cached by the calling thread to the shared pool
+         */
+        void flush() {
+            thread_cache *cache = local_cache_();
+            for (u_int32_t i = 0; i < TCACHE_CLASS_NUM; ++i)
+                spill_(cache->lists[i], i, cache->lists[i].size);
+        }
+
+        long size_used() const {
+            std::lock_guard guard(lock_);
+            return shared_.size_used();
+        }
+
+        long size_total() const {
+            std::lock_guard guard(lock_);
+            return shared_.size_total();
+        }
+
+        // =========================================== INTERNAL UTILS ==================================================
+
+        thread_cache *local_cache_() {
+            if (thread_cache *head = local_caches_.head; head != nullptr && head->owner == this)
+                return head;
+            return attach_();
+        }
+
+        thread_cache *attach_() {
+            thread_cache *found      = nullptr;
+            thread_cache *found_prev = nullptr;
+
+            for (thread_cache *head = local_caches_.head, *prev = nullptr; head != nullptr; prev = head, head = head->next) {
+                if (head->owner == this) {
+                    found      = head;
+                    found_prev = prev;
+                    break;
+                }
+                if (head->owner == nullptr && found == nullptr) {
+                    // cache left behind by destroyed allocator, reuse it
+                    found      = head;
+                    found_prev = prev;
+                }
+            }
+
+            if (found == nullptr) {
+                found = static_cast<thread_cache *>(::malloc(sizeof(thread_cache)));
+                if (found == nullptr)
+                    abort_("Memory allocation error");
+                *found = {};
+            } else if (found_prev != nullptr) {
+                found_prev->next = found->next;
+            } else {
+                local_caches_.head = found->next;
+            }
+
+            // move to front, so next lookup hits right away
+            found->next        = local_caches_.head;
+            local_caches_.head = found;
+
+            if (found->owner == this)
+                return found;
+
+            for (int i = 0; i < TCACHE_CLASS_NUM; ++i)
+                found->lists[i] = {};
+
+            std::lock_guard guard(registry_lock_());
+            found->owner    = this;
+            found->reg_prev = nullptr;
+            found->reg_next = caches_;
+            if (caches_ != nullptr)
+                caches_->reg_prev = found;
+            caches_ = found;
+            return found;
+        }
+
+        /**
+         * Called with registry lock held
+         */
+        void detach_(thread_cache *cache) {
+            for (u_int32_t i = 0; i < TCACHE_CLASS_NUM; ++i)
+                spill_(cache->lists[i], i, cache->lists[i].size);
+
+            if (cache->reg_prev != nullptr)
+                cache->reg_prev->reg_next = cache->reg_next;
+            else
+                caches_ = cache->reg_next;
+
+            if (cache->reg_next != nullptr)
+                cache->reg_next->reg_prev = cache->reg_prev;
+
+            cache->owner    = nullptr;
+            cache->reg_prev = nullptr;
+            cache->reg_next = nullptr;
+        }
+
+        void refill_(class_list &list, const u_int32_t size_class) {
+            std::lock_guard guard(lock_);
+
+            class_list &shared = central_[size_class];
+            while (shared.head != nullptr && list.size < TCACHE_BATCH_SIZE) {
+                free_object *object = shared.head;
+                shared.head = object->next;
+                shared.size--;
+
+                object->next = list.head;
+                list.head    = object;
+                list.size++;
+            }
+
+            const u_int32_t size_b = class_size_(size_class);
+            while (list.size < TCACHE_BATCH_SIZE) {
+                unsigned char *block  = static_cast<unsigned char *>(shared_.malloc(sizeof(object_header) + size_b, sizeof(object_header)));
+                unsigned char *data   = block + sizeof(object_header);
+                *header_(data) = { size_class, sizeof(object_header), size_b };
+
+                free_object *object = reinterpret_cast<free_object *>(data);
+                object->next = list.head;
+                list.head    = object;
+                list.size++;
+            }
+        }
+
+        void spill_(class_list &list, const u_int32_t size_class, u_int32_t n) {
+            if (list.head == nullptr || n == 0)
+                return;
+
+            std::lock_guard guard(lock_);
+
+            class_list &shared = central_[size_class];
+            while (n-- > 0 && list.head != nullptr) {
+                free_object *object = list.head;
+                list.head = object->next;
+                list.size--;
+
+                object->next = shared.head;
+                shared.head  = object;
+                shared.size++;
+            }
+
+            while (shared.size > TCACHE_SHARED_LIMIT) {
+                free_object *object = shared.head;
+                shared.head = object->next;
+                shared.size--;
+                shared_.free(reinterpret_cast<unsigned char *>(object) - sizeof(object_header));
+            }
+        }
+
+        void *large_malloc_(const std::size_t size_b, const std::size_t alignment_b) {
+            const std::size_t offset = alignment_b > sizeof(object_header) ? alignment_b : sizeof(object_header);
+
+            std::lock_guard guard(lock_);
+            unsigned char *block = static_cast<unsigned char *>(shared_.malloc(size_b + offset, offset));
+            unsigned char *data  = block + offset;
+            *header_(data) = { TCACHE_LARGE, static_cast<u_int32_t>(offset), size_b };
+            return data;
+        }
+
+        static object_header *header_(void *ptr) {
+            return reinterpret_cast<object_header *>(static_cast<unsigned char *>(ptr) - sizeof(object_header));
+        }
+
+        static u_int32_t size_class_(const std::size_t size_b) {
+            if (size_b > class_size_(TCACHE_CLASS_NUM - 1))
+                return TCACHE_LARGE;
+            if (size_b <= (1U << TCACHE_CLASS_MIN))
+                return 0;
+            return lalloc::power_range_r_(static_cast<u_int32_t>(size_b - 1)) + 1 - TCACHE_CLASS_MIN;
+        }
+
+        static constexpr u_int32_t class_size_(const u_int32_t size_class) {
+            return 1U << (size_class + TCACHE_CLASS_MIN);
+        }
+    };
+
+    inline thread_caches::~thread_caches() {
+        for (thread_cache *cache = head; cache != nullptr;) {
+            thread_cache *next = cache->next;
+            {
+                std::lock_guard guard(registry_lock_());
+                if (cache->owner != nullptr)
+                    cache->owner->detach_(cache);
+            }
+            ::free(cache);
+            cache = next;
+        }
+        head = nullptr;
+    }
+
+}
+
+#endif //EX_LIMBO_DATA_TCACHE_H
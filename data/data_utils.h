@@ -7,6 +7,7 @@
 
 #include "struct/array.h"
 #include "struct/array_map.h"
+#include "struct/hash_map.h"
 #include "struct/sorted_map.h"
 #include "struct/rmq_map.h"
 #include "struct/rb_map.h"
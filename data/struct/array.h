@@ -7,12 +7,50 @@
 
 #include "../alloc/datalloc.h"
 #include <cstring>
+#include <new>
+#include <type_traits>
+#include <utility>
 
 namespace ex::data {
 
-    template<typename val_t>
+// -----------------------------
+#ifndef ARRAY_GROWTH_NUM
+#define ARRAY_GROWTH_NUM (2) // capacity grows by NUM / DEN
+#endif
+
+#ifndef ARRAY_GROWTH_DEN
+#define ARRAY_GROWTH_DEN (1)
+#endif
+// -----------------------------
+
+    /**
+     * Types array may move around with realloc/memmove instead of move constructor + destructor.
+     * Trivially copyable ones by default, specialize for owning handles that are safe to move bytewise
+     */
+    template <typename T>
+    struct relocatable : std::bool_constant<std::is_trivially_copyable_v<T>> {};
+
+    template <typename val_t, int inline_n>
+    struct array_inline_ {
+        alignas(val_t) unsigned char bytes[inline_n * sizeof(val_t)];
+    };
+
+    template <typename val_t>
+    struct array_inline_<val_t, 0> {};
+
+    /**
+     * Growable array.
+     * <br/><br/>
+     * Relocatable values (see <b>relocatable</b>) grow through realloc and shift with memmove,
+     * everything else is move constructed into place and destroyed properly.
+     * First <b>inline_n</b> values live inside the array itself, no allocation until it outgrows them
+     */
+    template<typename val_t, int inline_n = 0>
     struct array {
 
+        static constexpr bool relocatable_ = relocatable<val_t>::value;
+        static constexpr bool copyable_    = std::is_trivially_copyable_v<val_t>;
+
         using comparator_fn = int8_t (*)(const val_t *a, const val_t *b);
         static int8_t default_comparator(const val_t *a, const val_t *b) {
             return (*a > *b) - (*a < *b);
@@ -20,9 +58,11 @@ namespace ex::data {
 
         allocator allocator_;
 
-        val_t *data     = nullptr;
+        val_t *data     = inline_();
         int    size     = 0;
-        int    capacity = 0;
+        int    capacity = inline_n;
+
+        [[no_unique_address]] array_inline_<val_t, inline_n> inline_data_;
 
         array() {
         }
@@ -32,17 +72,17 @@ namespace ex::data {
         }
 
         ~array() {
-            free_(this, allocator_, data);
-            data = nullptr;
+            destroy_(0, size);
+            release_();
         }
 
-        array(const int &capacity) : capacity(capacity) {
-            data = malloc_<val_t>(this, allocator_, capacity);
+        array(const int &capacity) {
+            reserve(capacity);
         }
 
-        array(const int &capacity, const allocator &allocator_) : capacity(capacity) {
+        array(const int &capacity, const allocator &allocator_) {
             this->allocator_ = allocator_;
-            data = malloc_<val_t>(this, this->allocator_, capacity);
+            reserve(capacity);
         }
 
         val_t &operator[](const int &index) {
@@ -69,27 +109,47 @@ namespace ex::data {
             return data[size - 1];
         }
 
+        /**
+         * Destroys the values and gives the memory back
+         */
         void clean() {
-            free_(this, allocator_, data);
-            this->data = nullptr;
+            destroy_(0, size);
+            release_();
+            data     = inline_();
             size     = 0;
-            capacity = 0;
+            capacity = inline_n;
+        }
+
+        /**
+         * Destroys the values, keeps the memory
+         */
+        void clear() {
+            destroy_(0, size);
+            size = 0;
         }
 
         void reserve(const int n) {
             if (n <= capacity)
                 return;
+            grow_to_(n);
+        }
 
-            if (data == nullptr)
-                data = malloc_<val_t>(this, allocator_, n);
-            else
-                data = realloc_<val_t>(this, allocator_, data, n);
-
-            capacity = n;
+        /**
+         * Value-initializes the new tail or destroys the cut one
+         */
+        void resize(const int n) {
+            if (n < size) {
+                destroy_(n, size);
+                size = n;
+                return;
+            }
+            reserve(n);
+            for (; size < n; ++size)
+                new (data + size) val_t();
         }
 
         int binary_search(const val_t &value, const comparator_fn compare = &default_comparator) const {
-            if (data == nullptr)
+            if (data == nullptr || size == 0)
                 return -1;
 
             //[n: 2]
@@ -161,7 +221,7 @@ namespace ex::data {
                 return size - 1;
             }
 
-            if (i <= 0) {
+            if (i < 0) {
                 insert(0, value);
                 return 0;
             }
@@ -174,34 +234,49 @@ namespace ex::data {
         }
 
         void insert(const int index, const val_t &value) {
-            if (size >= capacity) {
-                capacity = capacity > 0 ? (2 * capacity) : 2;
+            if (index >= size) {
+                push(value);
+                return;
+            }
+
+            val_t copy(value); // value may live in this array
+            if (size >= capacity)
+                grow_to_(next_capacity_());
 
-                if (data == nullptr)
-                    data = malloc_<val_t>(this, allocator_, capacity);
-                else
-                    data = realloc_<val_t>(this, allocator_, data, capacity);
+            if constexpr (relocatable_) {
+                ::memmove(static_cast<void *>(data + index + 1), data + index, (size - index) * sizeof(val_t));
+                new (data + index) val_t(std::move(copy));
+            }
+            else {
+                new (data + size) val_t(std::move(data[size - 1]));
+                for (int i = size - 1; i > index; --i)
+                    data[i] = std::move(data[i - 1]);
+                data[index] = std::move(copy);
             }
-            ::memmove(data + index + 1, data + index, (size - index) * sizeof(val_t));
-            data[index] = value;
             size++;
         }
 
         void push(const val_t &value) {
-            if (size >= capacity) {
-                capacity = capacity > 0 ? (2 * capacity) : 2;
+            emplace_back(value);
+        }
 
-                if (data == nullptr)
-                    data = malloc_<val_t>(this, allocator_, capacity);
-                else
-                    data = realloc_<val_t>(this, allocator_, data, capacity);
-            }
-            data[size++] = value;
+        void push(val_t &&value) {
+            emplace_back(std::move(value));
+        }
+
+        template <typename... A>
+        val_t &emplace_back(A &&...args) {
+            if (size < capacity)
+                return *new (data + size++) val_t(std::forward<A>(args)...);
+
+            val_t value(std::forward<A>(args)...); // arguments may refer to this array
+            grow_to_(next_capacity_());
+            return *new (data + size++) val_t(std::move(value));
         }
 
         void collapse(const int index) {
             if (index >= size - 1) {
-                size--;
+                pop();
                 return;
             }
 
@@ -212,12 +287,22 @@ namespace ex::data {
             // src: 5
             //   n: 2 = size(7) - index(4) - 1
 
-            ::memmove(data + index, data + index + 1, (size - index - 1) * sizeof(val_t));
+            if constexpr (relocatable_) {
+                data[index].~val_t();
+                ::memmove(static_cast<void *>(data + index), data + index + 1, (size - index - 1) * sizeof(val_t));
+            }
+            else {
+                for (int i = index; i < size - 1; ++i)
+                    data[i] = std::move(data[i + 1]);
+                data[size - 1].~val_t();
+            }
             size--;
         }
 
         void pop() {
-            size = (size > 0) ? (size - 1) : 0;
+            if (size <= 0)
+                return;
+            data[--size].~val_t();
         }
 
         bool empty() const {
@@ -259,61 +344,32 @@ namespace ex::data {
         }
 
         void swap(const int index_1, const int index_2) {
-            const val_t tmp = data[index_1];
-            data[index_1]       = data[index_2];
-            data[index_2]       = tmp;
+            val_t tmp     = std::move(data[index_1]);
+            data[index_1] = std::move(data[index_2]);
+            data[index_2] = std::move(tmp);
         }
 
         void swap_remove(const int &index) {
-            const val_t tmp = data[index];
-            data[index]         = data[size - 1];
-            data[size - 1]      = tmp;
-            size                = (size > 0) ? (size - 1) : 0;
+            if (index != size - 1)
+                data[index] = std::move(data[size - 1]);
+            pop();
         }
 
-        array(const array &other) : size(other.size), capacity(other.capacity) {
-            if (other.capacity <= 0) {
-                data = nullptr;
-                return;
-            }
-
-            allocator_ = other.allocator_;
-
-            data = malloc_<val_t>(this, allocator_, other.capacity);
-
-            if (other.size <= 0)
-                return;
-
-            ::memcpy(data, other.data, other.size * sizeof(val_t));
+        array(const array &other) : allocator_(other.allocator_) {
+            copy_from_(other);
         }
 
-        array(array &&other) noexcept : size(other.size), capacity(other.capacity) {
-            this->data = other.data;
-            other.data = nullptr;
+        array(array &&other) noexcept : allocator_(other.allocator_) {
+            take_from_(other);
         }
 
         array &operator = (const array &other) {
             if (this == &other)
                 return *this;
 
-            free_(this, allocator_, data);
-            data = nullptr;
-
-            size       = other.size;
-            capacity   = other.capacity;
+            clean();
             allocator_ = other.allocator_;
-
-            if (other.capacity <= 0) {
-                data = nullptr;
-                return *this;
-            }
-
-            data = malloc_<val_t>(this, other.allocator_, other.capacity);
-
-            if (other.size <= 0)
-                return *this;
-
-            ::memcpy(data, other.data, other.size * sizeof(val_t));
+            copy_from_(other);
             return *this;
         }
 
@@ -321,15 +377,9 @@ namespace ex::data {
             if (this == &other)
                 return *this;
 
-            free_(this, allocator_, data);
-            data = nullptr;
-
-            this->data       = other.data;
-            this->size       = other.size;
-            this->capacity   = other.capacity;
-            this->allocator_ = other.allocator_;
-            other.data       = nullptr;
-
+            clean();
+            allocator_ = other.allocator_;
+            take_from_(other);
             return *this;
         }
 
@@ -388,21 +438,132 @@ namespace ex::data {
             return iterator(data + size);
         }
 
+        // =========================================== INTERNAL UTILS ==================================================
+
+        val_t *inline_() {
+            if constexpr (inline_n > 0)
+                return reinterpret_cast<val_t *>(inline_data_.bytes);
+            return nullptr;
+        }
+
+        bool on_heap_() const {
+            if constexpr (inline_n > 0)
+                return data != reinterpret_cast<const val_t *>(inline_data_.bytes);
+            return data != nullptr;
+        }
+
+        int next_capacity_() const {
+            const long grown = static_cast<long>(capacity) * ARRAY_GROWTH_NUM / ARRAY_GROWTH_DEN;
+            return static_cast<int>(grown > capacity ? grown : (capacity > 0 ? capacity + 1 : 2));
+        }
+
+        void destroy_(const int from, const int to) {
+            if constexpr (!std::is_trivially_destructible_v<val_t>)
+                for (int i = from; i < to; ++i)
+                    data[i].~val_t();
+        }
+
+        void release_() {
+            if (on_heap_())
+                free_<val_t>(this, allocator_, data, capacity);
+        }
+
+        /**
+         * Relocatable heap data is realloc'ed (in place if the allocator can), the rest moves to a fresh block
+         */
+        void grow_to_(const int n) {
+            if (relocatable_ && on_heap_()) {
+                data     = realloc_<val_t>(this, allocator_, data, n);
+                capacity = n;
+                return;
+            }
+
+            val_t *moved = malloc_<val_t>(this, allocator_, n);
+            if constexpr (relocatable_) {
+                if (size > 0)
+                    ::memcpy(static_cast<void *>(moved), data, size * sizeof(val_t));
+            }
+            else {
+                for (int i = 0; i < size; ++i) {
+                    new (moved + i) val_t(std::move(data[i]));
+                    data[i].~val_t();
+                }
+            }
+            release_();
+            data     = moved;
+            capacity = n;
+        }
+
+        void copy_from_(const array &other) {
+            data     = inline_();
+            size     = 0;
+            capacity = inline_n;
+            reserve(other.capacity);
+
+            if constexpr (copyable_) {
+                if (other.size > 0)
+                    ::memcpy(static_cast<void *>(data), other.data, other.size * sizeof(val_t));
+                size = other.size;
+            }
+            else {
+                for (; size < other.size; ++size)
+                    new (data + size) val_t(other.data[size]);
+            }
+        }
+
+        /**
+         * Steals the heap block, inline values are moved one by one. <b>other</b> is left empty
+         */
+        void take_from_(array &other) {
+            if (other.on_heap_()) {
+                data     = other.data;
+                size     = other.size;
+                capacity = other.capacity;
+            }
+            else {
+                data     = inline_();
+                capacity = inline_n;
+                for (size = 0; size < other.size; ++size) {
+                    new (data + size) val_t(std::move(other.data[size]));
+                    other.data[size].~val_t();
+                }
+            }
+            other.data     = other.inline_();
+            other.size     = 0;
+            other.capacity = inline_n;
+        }
+
         template <typename T>
         T *malloc_(void *, allocator &allocator, const std::size_t size_n) {
-            return static_cast<T *>(allocator.malloc(&allocator, size_n * sizeof(T), sizeof(T)));
+            return static_cast<T *>(allocator.malloc(&allocator, size_n * sizeof(T), alignof(T)));
         }
 
+        /**
+         * Grows in place when the allocator can, realloc (and copy) otherwise
+         */
         template <typename T>
         T *realloc_(void *, allocator &allocator, T *const ptr, const std::size_t size_n) {
+            if (allocator.try_expand != nullptr && allocator.try_expand(&allocator, ptr, size_n * sizeof(T)))
+                return ptr;
             return static_cast<T *>(allocator.realloc(&allocator, ptr, size_n * sizeof(T)));
         }
 
-        static void free_(void *, allocator &allocator, void *ptr) {
-            if (allocator.free != nullptr && ptr != nullptr)
+        template <typename T>
+        static void free_(void *, allocator &allocator, T *ptr, const std::size_t size_n) {
+            if (allocator.free == nullptr || ptr == nullptr)
+                return;
+            if (allocator.free_sized != nullptr)
+                allocator.free_sized(&allocator, ptr, size_n * sizeof(T), alignof(T));
+            else
                 allocator.free(&allocator, ptr);
         }
     };
+
+    /**
+     * Small buffer array: up to <b>inline_n</b> values inside the object, spills to the allocator past that
+     */
+    template<typename val_t, int inline_n>
+    using inline_array = array<val_t, inline_n>;
 }
 
 #endif //EX_LIMBO_DATA_ARRAY_H
@@ -6,19 +6,32 @@
 #define EX_LIMBO_DATA_ARRAY_MAP_H
 
 #include "array.h"
+#include <type_traits>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
 
 namespace ex::data {
 
-    template<typename key_t, typename val_t>
-    struct array_map { // linear time map, perfect for small data sets ( < ~1000) due to cache locality
+    /**
+     * Linear time map, perfect for small data sets ( < ~1000) due to cache locality.
+     * First <b>inline_n</b> entries live inside the map itself (see <b>inline_array</b>)
+     */
+    template<typename key_t, typename val_t, int inline_n = 0>
+    struct array_map {
 
         struct entry {
             key_t key;
             val_t val;
         };
 
-        array<key_t> key_entries;
-        array<val_t> val_entries;
+        array<key_t, inline_n> key_entries;
+        array<val_t, inline_n> val_entries;
 
         const int &capacity = key_entries.capacity;
         const int &size     = key_entries.size;
@@ -44,8 +57,8 @@ namespace ex::data {
         }
 
         array_map(array_map &&src) noexcept :
-            key_entries(static_cast<array<key_t> &&>(src.key_entries)),
-            val_entries(static_cast<array<val_t> &&>(src.val_entries)) {
+            key_entries(static_cast<array<key_t, inline_n> &&>(src.key_entries)),
+            val_entries(static_cast<array<val_t, inline_n> &&>(src.val_entries)) {
         }
 
         array_map &operator = (const array_map &other) {
@@ -59,8 +72,8 @@ namespace ex::data {
         array_map &operator = (array_map &&other) noexcept {
             if (this == &other)
                 return *this;
-            key_entries = static_cast<array<key_t> &&>(other.key_entries);
-            val_entries = static_cast<array<val_t> &&>(other.val_entries);
+            key_entries = static_cast<array<key_t, inline_n> &&>(other.key_entries);
+            val_entries = static_cast<array<val_t, inline_n> &&>(other.val_entries);
             return *this;
         }
 
@@ -69,56 +82,48 @@ namespace ex::data {
         }
 
         void put(const key_t &key, const val_t &element) {
-            for (int i = 0; i < key_entries.size; ++i) {
-                if (key_entries[i] == key) {
-                    val_entries[i] = element;
-                    return;
-                }
+            if (const int i = find_(key); i >= 0) {
+                val_entries[i] = element;
+                return;
             }
             key_entries.push(key);
             val_entries.push(element);
         }
 
         val_t &operator [] (const key_t &key) {
-            for (int i = 0; i < key_entries.size; ++i) {
-                if (key_entries[i] == key)
-                    return val_entries[i];
-            }
+            if (const int i = find_(key); i >= 0)
+                return val_entries[i];
             key_entries.push(key);
             val_entries.push(val_t());
             return val_entries[val_entries.size - 1];
         }
 
         const val_t &operator [] (const key_t &key) const {
-            for (int i = 0; i < key_entries.size; ++i) {
-                if (key_entries[i] == key)
-                    return val_entries[i];
-            }
-            abort();
+            const int i = find_(key);
+            if (i < 0)
+                abort();
+            return val_entries[i];
         }
 
         int index_at(const key_t &key) const {
-            for (int i = 0; i < key_entries.size; ++i) {
-                if (key_entries[i] == key)
-                    return i;
-            }
-            abort();
+            const int i = find_(key);
+            if (i < 0)
+                abort();
+            return i;
         }
 
         val_t &at(const key_t &key) {
-            for (int i = 0; i < key_entries.size; ++i) {
-                if (key_entries[i] == key)
-                    return val_entries[i];
-            }
-            abort();
+            const int i = find_(key);
+            if (i < 0)
+                abort();
+            return val_entries[i];
         }
 
         const val_t &at(const key_t &key) const {
-            for (int i = 0; i < key_entries.size; ++i) {
-                if (key_entries[i] == key)
-                    return val_entries[i];
-            }
-            abort();
+            const int i = find_(key);
+            if (i < 0)
+                abort();
+            return val_entries[i];
         }
 
         const val_t &at_index(const int &index) const {
@@ -130,38 +135,25 @@ namespace ex::data {
         }
 
         val_t at_or_default(const key_t &key, const val_t &default_value = val_t()) const {
-            for (int i = 0; i < key_entries.size; ++i) {
-                if (key_entries[i] == key)
-                    return val_entries[i];
-            }
-            return default_value;
+            const int i = find_(key);
+            return i >= 0 ? val_entries[i] : default_value;
         }
 
         bool contains(const key_t &key) const {
-            for (int i = 0; i < key_entries.size; ++i) {
-                if (key_entries[i] == key)
-                    return true;
-            }
-            return false;
+            return find_(key) >= 0;
         }
 
         void remove(const key_t &key) {
-            for (int i = 0; i < key_entries.size; ++i) {
-                if (key_entries[i] == key) {
-                    key_entries.swap_remove(i);
-                    val_entries.swap_remove(i);
-                    return;
-                }
+            if (const int i = find_(key); i >= 0) {
+                key_entries.swap_remove(i);
+                val_entries.swap_remove(i);
             }
         }
 
         void collapse(const key_t &key) {
-            for (int i = 0; i < key_entries.size; ++i) {
-                if (key_entries[i] == key) {
-                    key_entries.collapse(i);
-                    val_entries.collapse(i);
-                    return;
-                }
+            if (const int i = find_(key); i >= 0) {
+                key_entries.collapse(i);
+                val_entries.collapse(i);
             }
         }
 
@@ -194,8 +186,92 @@ namespace ex::data {
             key_entries.reserve(n);
             val_entries.reserve(n);
         }
+
+        // =========================================== INTERNAL UTILS ==================================================
+
+        /**
+         * Keys compared bitwise by the vector scan: integers, enums and pointers of 1, 2, 4 or 8 bytes
+         */
+        static constexpr bool simd_key_ = (std::is_integral_v<key_t> || std::is_enum_v<key_t> || std::is_pointer_v<key_t>) &&
+                                          (sizeof(key_t) == 1 || sizeof(key_t) == 2 || sizeof(key_t) == 4 || sizeof(key_t) == 8);
+
+        int find_(const key_t &key) const {
+            const key_t *keys = key_entries.data;
+            const int    n    = key_entries.size;
+            int          i    = 0;
+
+            if constexpr (simd_key_) {
+                u_int64_t bits = 0;
+                ::memcpy(&bits, &key, sizeof(key_t));
+
+                #if defined(__AVX2__)
+                constexpr int lanes  = 32 / sizeof(key_t);
+                const __m256i needle = sizeof(key_t) == 1 ? _mm256_set1_epi8(static_cast<char>(bits))
+                                     : sizeof(key_t) == 2 ? _mm256_set1_epi16(static_cast<short>(bits))
+                                     : sizeof(key_t) == 4 ? _mm256_set1_epi32(static_cast<int>(bits))
+                                                          : _mm256_set1_epi64x(static_cast<long long>(bits));
+                for (; i + lanes <= n; i += lanes) {
+                    const __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(keys + i));
+                    __m256i       equal;
+                    if constexpr (sizeof(key_t) == 1)      equal = _mm256_cmpeq_epi8(block, needle);
+                    else if constexpr (sizeof(key_t) == 2) equal = _mm256_cmpeq_epi16(block, needle);
+                    else if constexpr (sizeof(key_t) == 4) equal = _mm256_cmpeq_epi32(block, needle);
+                    else                                   equal = _mm256_cmpeq_epi64(block, needle);
+                    if (const u_int32_t mask = static_cast<u_int32_t>(_mm256_movemask_epi8(equal)); mask != 0)
+                        return i + static_cast<int>(__builtin_ctz(mask) / sizeof(key_t));
+                }
+                #elif defined(__SSE2__)
+                constexpr int lanes  = 16 / sizeof(key_t);
+                const __m128i needle = sizeof(key_t) == 1 ? _mm_set1_epi8(static_cast<char>(bits))
+                                     : sizeof(key_t) == 2 ? _mm_set1_epi16(static_cast<short>(bits))
+                                     : sizeof(key_t) == 4 ? _mm_set1_epi32(static_cast<int>(bits))
+                                                          : _mm_set1_epi64x(static_cast<long long>(bits));
+                for (; i + lanes <= n; i += lanes) {
+                    const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i *>(keys + i));
+                    __m128i       equal;
+                    if constexpr (sizeof(key_t) == 1)      equal = _mm_cmpeq_epi8(block, needle);
+                    else if constexpr (sizeof(key_t) == 2) equal = _mm_cmpeq_epi16(block, needle);
+                    else if constexpr (sizeof(key_t) == 4) equal = _mm_cmpeq_epi32(block, needle);
+                    else {
+                        // no 64-bit compare in SSE2: both 32-bit halves have to match
+                        equal = _mm_cmpeq_epi32(block, needle);
+                        equal = _mm_and_si128(equal, _mm_shuffle_epi32(equal, _MM_SHUFFLE(2, 3, 0, 1)));
+                    }
+                    if (const u_int32_t mask = static_cast<u_int32_t>(_mm_movemask_epi8(equal)); mask != 0)
+                        return i + static_cast<int>(__builtin_ctz(mask) / sizeof(key_t));
+                }
+                #elif defined(__ARM_NEON)
+                constexpr int lanes = 16 / sizeof(key_t);
+                for (; i + lanes <= n; i += lanes) {
+                    const u_int8_t *block = reinterpret_cast<const u_int8_t *>(keys + i);
+                    uint8x16_t      equal;
+                    if constexpr (sizeof(key_t) == 1)
+                        equal = vceqq_u8(vld1q_u8(block), vdupq_n_u8(static_cast<u_int8_t>(bits)));
+                    else if constexpr (sizeof(key_t) == 2)
+                        equal = vreinterpretq_u8_u16(vceqq_u16(vld1q_u16(reinterpret_cast<const u_int16_t *>(block)), vdupq_n_u16(static_cast<u_int16_t>(bits))));
+                    else if constexpr (sizeof(key_t) == 4)
+                        equal = vreinterpretq_u8_u32(vceqq_u32(vld1q_u32(reinterpret_cast<const u_int32_t *>(block)), vdupq_n_u32(static_cast<u_int32_t>(bits))));
+                    else
+                        equal = vreinterpretq_u8_u64(vceqq_u64(vld1q_u64(reinterpret_cast<const u_int64_t *>(block)), vdupq_n_u64(bits)));
+                    // 4 bits per byte, first match is the lowest set nibble
+                    const u_int64_t mask = vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(equal), 4)), 0);
+                    if (mask != 0)
+                        return i + static_cast<int>(__builtin_ctzll(mask) / (4 * sizeof(key_t)));
+                }
+                #endif
+            }
+
+            for (; i < n; ++i) {
+                if (keys[i] == key)
+                    return i;
+            }
+            return -1;
+        }
     };
 
+    template<typename key_t, typename val_t, int inline_n>
+    using inline_array_map = array_map<key_t, val_t, inline_n>;
+
 }
 
 #endif //EX_LIMBO_DATA_ARRAY_MAP_H
@@ -33,7 +33,7 @@ namespace ex::data {
         }
 
         ~buffer() {
-            free_(this, allocator_, data);
+            free_<element_t>(this, allocator_, data, size);
             this->data = nullptr;
             this->size = 0;
         }
@@ -59,7 +59,7 @@ namespace ex::data {
                 return;
             }
 
-            data = malloc_<element_t>(this, other.allocator_, other.size);
+            data = malloc_<element_t>(this, allocator_, other.size);
             memcpy(data, other.data, other.size * sizeof(element_t));
         }
 
@@ -72,7 +72,7 @@ namespace ex::data {
             if (this == &other)
                 return *this;
 
-            free_(this, allocator_, data);
+            free_<element_t>(this, allocator_, data, size);
             data = nullptr;
 
             allocator_ = other.allocator_;
@@ -83,7 +83,7 @@ namespace ex::data {
                 return *this;
             }
 
-            data = malloc_<element_t>(this, other.allocator_, other.size);
+            data = malloc_<element_t>(this, allocator_, other.size);
             memcpy(data, other.data, other.size * sizeof(element_t));
 
             return *this;
@@ -93,7 +93,7 @@ namespace ex::data {
             if (this == &other)
                 return *this;
 
-            free_(this, allocator_, data);
+            free_<element_t>(this, allocator_, data, size);
             data = nullptr;
 
             this->allocator_ = other.allocator_;
@@ -109,13 +109,23 @@ namespace ex::data {
             return static_cast<T *>(allocator.malloc(&allocator, size_n * sizeof(T), sizeof(T)));
         }
 
+        /**
+         * Grows in place when the allocator can, realloc (and copy) otherwise
+         */
         template <typename T>
         T *realloc_(void *, allocator &allocator, T *const ptr, const std::size_t size_n) {
+            if (allocator.try_expand != nullptr && allocator.try_expand(&allocator, ptr, size_n * sizeof(T)))
+                return ptr;
             return static_cast<T *>(allocator.realloc(&allocator, ptr, size_n * sizeof(T)));
         }
 
-        static void free_(void *, allocator &allocator, void *ptr) {
-            if (allocator.free != nullptr && ptr != nullptr)
+        template <typename T>
+        static void free_(void *, allocator &allocator, T *ptr, const std::size_t size_n) {
+            if (allocator.free == nullptr || ptr == nullptr)
+                return;
+            if (allocator.free_sized != nullptr)
+                allocator.free_sized(&allocator, ptr, size_n * sizeof(T), sizeof(T));
+            else
                 allocator.free(&allocator, ptr);
         }
     };
@@ -83,8 +83,8 @@ namespace ex::data {
         }
 
         void evict() {
-            store_data.size = 0;
-            store_id.size   = 0;
+            store_data.clear();
+            store_id.clear();
             index           = 0;
             status          = EVICTED;
         }
@@ -0,0 +1,490 @@
+//
+// Created by henryco on 17/10/26.
+//
+
+#ifndef EX_LIMBO_DATA_FLAT_RMQ_MAP_H
+#define EX_LIMBO_DATA_FLAT_RMQ_MAP_H
+
+#include "../alloc/datalloc.h"
+#include <functional>
+#include <cstring>
+#include <new>
+
+namespace ex::data {
+
+#define FLAT_NODES_MIN  (64)
+#define FLAT_NODES_LINE (64) // node array alignment, nodes never straddle a cache line when sizeof divides it
+
+    /**
+     * Compact range-max map: treap over a contiguous node array linked by 32-bit indices,
+     * every node carries its subtree max next to its own range value.
+     * No parent links and no colour, priorities are derived from the key hash,
+     * so <b>[void *, 8 byte val, u_int32_t]</b> nodes are 32 bytes, two per cache line.
+     * <br/><br/>
+     * Node pointers are only valid until the next insert (the array may move).
+     * Subtrees are pruned by max only, i.e. range_fit is built for <b>[min, +inf)</b> style queries.
+     */
+    template<typename key_t, typename val_t, typename rmq_t>
+    struct flat_rmq_map {
+
+        using index_t = u_int32_t;
+
+        struct rmq_node {
+            key_t   key;
+            val_t   val;
+            rmq_t   rmq;
+            rmq_t   max; // subtree max
+            index_t lns;
+            index_t rns;
+        };
+
+        using range_test_fn = bool (*) (const rmq_node *node, void *this_);
+        using comparator_fn = int32_t (*)(const key_t *a, const key_t *b);
+
+        static int32_t default_comparator(const key_t *a, const key_t *b) {
+            return (*a > *b) - (*a < *b);
+        }
+
+        allocator allocator_;
+
+        comparator_fn comp_;
+        rmq_node     *nodes_    = nullptr; // [0] is nil
+        index_t       capacity_ = 0;
+        index_t       used_     = 1;       // high water mark
+        index_t       free_     = 0;       // released slots chained through lns
+        index_t       root_     = 0;
+        int64_t       size_     = 0;
+
+        flat_rmq_map():
+            comp_(&flat_rmq_map::default_comparator) {
+        }
+
+        flat_rmq_map(const comparator_fn compare_key):
+            comp_(compare_key) {
+        }
+
+        flat_rmq_map(const allocator &allocator_, const comparator_fn compare_key):
+            comp_(compare_key) {
+            this->allocator_ = allocator_;
+        }
+
+        flat_rmq_map(const flat_rmq_map &other) = delete;
+        flat_rmq_map &operator = (const flat_rmq_map &other) = delete;
+
+        flat_rmq_map(flat_rmq_map &&other) noexcept:
+            allocator_(other.allocator_), comp_(other.comp_), nodes_(other.nodes_), capacity_(other.capacity_),
+            used_(other.used_), free_(other.free_), root_(other.root_), size_(other.size_) {
+            other.nodes_    = nullptr;
+            other.capacity_ = 0;
+            other.used_     = 1;
+            other.free_     = 0;
+            other.root_     = 0;
+            other.size_     = 0;
+        }
+
+        ~flat_rmq_map() {
+            release_();
+        }
+
+        void clean() {
+            release_();
+            nodes_    = nullptr;
+            capacity_ = 0;
+            used_     = 1;
+            free_     = 0;
+            root_     = 0;
+            size_     = 0;
+        }
+
+        bool empty() const {
+            return size_ <= 0;
+        }
+
+        int64_t size() const {
+            return size_;
+        }
+
+        /**
+         * Bytes of node storage (metadata footprint)
+         */
+        std::size_t size_bytes() const {
+            return static_cast<std::size_t>(capacity_) * sizeof(rmq_node);
+        }
+
+        bool contains(const key_t &key) const {
+            return find_(key) != 0;
+        }
+
+        val_t &at(const key_t &key) const {
+            const index_t i = find_(key);
+            if (i == 0)
+                abort_(""); // all or nothing, avoid exceptions
+            return nodes_[i].val;
+        }
+
+        const val_t &operator [] (const key_t &key) const {
+            return at(key);
+        }
+
+        void put(const key_t &key, const val_t &val, const rmq_t &range) {
+            if (update_(root_, key, val, range))
+                return;
+
+            const index_t node = instance_node_();
+            nodes_[node].key = key;
+            nodes_[node].val = val;
+            nodes_[node].rmq = range;
+            nodes_[node].max = range;
+            nodes_[node].lns = 0;
+            nodes_[node].rns = 0;
+
+            root_ = insert_(root_, node);
+            size_++;
+        }
+
+        void remove(const key_t &key) {
+            bool removed = false;
+            root_ = remove_(root_, key, &removed);
+            size_ -= removed;
+        }
+
+        /**
+         * Smallest key greater than the given one (which does not have to be present)
+         */
+        rmq_node *next(const key_t &key) const {
+            index_t found = 0;
+            for (index_t i = root_; i != 0;) {
+                if (comp_(&key, &nodes_[i].key) < 0) {
+                    found = i;
+                    i     = nodes_[i].lns;
+                } else {
+                    i = nodes_[i].rns;
+                }
+            }
+            return node_(found);
+        }
+
+        /**
+         * Greatest key less than the given one (which does not have to be present)
+         */
+        rmq_node *prev(const key_t &key) const {
+            index_t found = 0;
+            for (index_t i = root_; i != 0;) {
+                if (comp_(&key, &nodes_[i].key) > 0) {
+                    found = i;
+                    i     = nodes_[i].rns;
+                } else {
+                    i = nodes_[i].lns;
+                }
+            }
+            return node_(found);
+        }
+
+        rmq_node *first() const {
+            index_t i = root_;
+            while (i != 0 && nodes_[i].lns != 0)
+                i = nodes_[i].lns;
+            return node_(i);
+        }
+
+        rmq_node *last() const {
+            index_t i = root_;
+            while (i != 0 && nodes_[i].rns != 0)
+                i = nodes_[i].rns;
+            return node_(i);
+        }
+
+        rmq_node *range_fit(const rmq_t &val, const range_test_fn test = nullptr, void *test_this = nullptr) const {
+            return range_fit(val, val, test, test_this);
+        }
+
+        rmq_node *range_fit(const rmq_t &min, const rmq_t &max, const range_test_fn test = nullptr, void *test_this = nullptr) const {
+            return node_(fit_(root_, min, max, test, test_this));
+        }
+
+        /**
+         * Same as range_fit, but returns the fitting node with the lowest key
+         */
+        rmq_node *range_fit_first(const rmq_t &min, const rmq_t &max, const range_test_fn test = nullptr, void *test_this = nullptr) const {
+            return node_(fit_first_(root_, min, max, test, test_this));
+        }
+
+        /**
+         * Fitting node with the smallest range value, lowest key on ties.
+         * Visits every subtree reaching <b>min</b> until a node equal to <b>min</b> is found.
+         */
+        rmq_node *range_fit_best(const rmq_t &min, const rmq_t &max, const range_test_fn test = nullptr, void *test_this = nullptr) const {
+            index_t best = 0;
+            fit_best_(root_, min, max, test, test_this, &best);
+            return node_(best);
+        }
+
+        rmq_node *range_max() const {
+            if (root_ == 0)
+                return nullptr;
+            return range_fit(nodes_[root_].max, nodes_[root_].max);
+        }
+
+        /**
+         * Node range changed in place, refreshes maxes on the path from the root
+         */
+        void update_ranges_(rmq_node *const node) {
+            update_path_(root_, node->key);
+        }
+
+        // =========================================== INTERNAL UTILS ==================================================
+
+        rmq_node *node_(const index_t i) const {
+            return i == 0 ? nullptr : &nodes_[i];
+        }
+
+        index_t find_(const key_t &key) const {
+            for (index_t i = root_; i != 0;) {
+                const int32_t c = comp_(&key, &nodes_[i].key);
+                if (c == 0)
+                    return i;
+                i = c < 0 ? nodes_[i].lns : nodes_[i].rns;
+            }
+            return 0;
+        }
+
+        index_t fit_(index_t i, const rmq_t &min, const rmq_t &max, const range_test_fn test, void *test_this) const {
+            while (i != 0 && !(nodes_[i].max < min)) {
+                const rmq_node &node = nodes_[i];
+                if (fits_(i, min, max, test, test_this))
+                    return i;
+
+                const bool fit_l = node.lns != 0 && !(nodes_[node.lns].max < min);
+                const bool fit_r = node.rns != 0 && !(nodes_[node.rns].max < min);
+                if (fit_l && fit_r) {
+                    if (const index_t l = fit_(node.lns, min, max, test, test_this))
+                        return l;
+                    i = node.rns;
+                    continue;
+                }
+                i = fit_l ? node.lns : fit_r ? node.rns : 0;
+            }
+            return 0;
+        }
+
+        bool fits_(const index_t i, const rmq_t &min, const rmq_t &max, const range_test_fn test, void *test_this) const {
+            const rmq_node &node = nodes_[i];
+            return !(node.rmq < min) && !(max < node.rmq) && (test == nullptr || test(&node, test_this));
+        }
+
+        index_t fit_first_(const index_t i, const rmq_t &min, const rmq_t &max, const range_test_fn test, void *test_this) const {
+            if (i == 0 || nodes_[i].max < min)
+                return 0;
+            if (const index_t found = fit_first_(nodes_[i].lns, min, max, test, test_this))
+                return found;
+            if (fits_(i, min, max, test, test_this))
+                return i;
+            return fit_first_(nodes_[i].rns, min, max, test, test_this);
+        }
+
+        void fit_best_(const index_t i, const rmq_t &min, const rmq_t &max, const range_test_fn test, void *test_this, index_t *best) const {
+            if (i == 0 || nodes_[i].max < min)
+                return;
+            if (*best != 0 && !(min < nodes_[*best].rmq))
+                return; // exact fit, nothing smaller left
+            fit_best_(nodes_[i].lns, min, max, test, test_this, best);
+            if ((*best == 0 || nodes_[i].rmq < nodes_[*best].rmq) && fits_(i, min, max, test, test_this))
+                *best = i;
+            fit_best_(nodes_[i].rns, min, max, test, test_this, best);
+        }
+
+        void pull_(const index_t i) {
+            rmq_node &node = nodes_[i];
+            node.max = node.rmq;
+            if (node.lns != 0 && node.max < nodes_[node.lns].max)
+                node.max = nodes_[node.lns].max;
+            if (node.rns != 0 && node.max < nodes_[node.rns].max)
+                node.max = nodes_[node.rns].max;
+        }
+
+        void update_path_(const index_t i, const key_t &key) {
+            if (i == 0)
+                return;
+            const int32_t c = comp_(&key, &nodes_[i].key);
+            if (c != 0)
+                update_path_(c < 0 ? nodes_[i].lns : nodes_[i].rns, key);
+            pull_(i);
+        }
+
+        /**
+         * Updates the node in place if the key is present, maxes are refreshed only along the path
+         */
+        bool update_(const index_t i, const key_t &key, const val_t &val, const rmq_t &range) {
+            if (i == 0)
+                return false;
+            const int32_t c = comp_(&key, &nodes_[i].key);
+            if (c == 0) {
+                nodes_[i].val = val;
+                nodes_[i].rmq = range;
+            } else if (!update_(c < 0 ? nodes_[i].lns : nodes_[i].rns, key, val, range)) {
+                return false;
+            }
+            pull_(i);
+            return true;
+        }
+
+        /**
+         * Splits by key (which is not in the tree): l < key < r
+         */
+        void split_(const index_t i, const key_t &key, index_t *l, index_t *r) {
+            if (i == 0) {
+                *l = 0;
+                *r = 0;
+                return;
+            }
+            if (comp_(&key, &nodes_[i].key) < 0) {
+                split_(nodes_[i].lns, key, l, &nodes_[i].lns);
+                *r = i;
+            } else {
+                split_(nodes_[i].rns, key, &nodes_[i].rns, r);
+                *l = i;
+            }
+            pull_(i);
+        }
+
+        index_t merge_(const index_t l, const index_t r) {
+            if (l == 0)
+                return r;
+            if (r == 0)
+                return l;
+            if (priority_(nodes_[l].key) > priority_(nodes_[r].key)) {
+                nodes_[l].rns = merge_(nodes_[l].rns, r);
+                pull_(l);
+                return l;
+            }
+            nodes_[r].lns = merge_(l, nodes_[r].lns);
+            pull_(r);
+            return r;
+        }
+
+        index_t insert_(const index_t i, const index_t node) {
+            if (i == 0)
+                return node;
+            if (priority_(nodes_[node].key) > priority_(nodes_[i].key)) {
+                split_(i, nodes_[node].key, &nodes_[node].lns, &nodes_[node].rns);
+                pull_(node);
+                return node;
+            }
+            if (comp_(&nodes_[node].key, &nodes_[i].key) < 0)
+                nodes_[i].lns = insert_(nodes_[i].lns, node);
+            else
+                nodes_[i].rns = insert_(nodes_[i].rns, node);
+            pull_(i);
+            return i;
+        }
+
+        index_t remove_(const index_t i, const key_t &key, bool *removed) {
+            if (i == 0)
+                return 0;
+            const int32_t c = comp_(&key, &nodes_[i].key);
+            if (c == 0) {
+                const index_t merged = merge_(nodes_[i].lns, nodes_[i].rns);
+                release_node_(i);
+                *removed = true;
+                return merged;
+            }
+            if (c < 0)
+                nodes_[i].lns = remove_(nodes_[i].lns, key, removed);
+            else
+                nodes_[i].rns = remove_(nodes_[i].rns, key, removed);
+            if (*removed)
+                pull_(i);
+            return i;
+        }
+
+        static u_int32_t priority_(const key_t &key) {
+            u_int64_t x = static_cast<u_int64_t>(std::hash<key_t>{}(key));
+            x ^= x >> 33;
+            x *= 0xff51afd7ed558ccdULL;
+            x ^= x >> 33;
+            x *= 0xc4ceb9fe1a85ec53ULL;
+            x ^= x >> 33;
+            return static_cast<u_int32_t>(x);
+        }
+
+        index_t instance_node_() {
+            if (free_ != 0) {
+                const index_t i = free_;
+                free_ = nodes_[i].lns;
+                return i;
+            }
+            if (used_ >= capacity_)
+                grow_();
+            return used_++;
+        }
+
+        void release_node_(const index_t i) {
+            nodes_[i].lns = free_;
+            free_         = i;
+        }
+
+        /**
+         * Not realloc: the array has to stay cache-line aligned
+         */
+        void grow_() {
+            const index_t capacity = capacity_ > 0 ? capacity_ * 2 : FLAT_NODES_MIN;
+            if (capacity <= capacity_)
+                abort_("flat_rmq_map index overflow");
+
+            auto *nodes = static_cast<rmq_node *>(allocator_.malloc(&allocator_, capacity * sizeof(rmq_node), FLAT_NODES_LINE));
+            if (nodes == nullptr)
+                abort_("Memory allocation error");
+            if (nodes_ != nullptr) {
+                ::memcpy(static_cast<void *>(nodes), nodes_, used_ * sizeof(rmq_node));
+                release_();
+            }
+            nodes_    = nodes;
+            capacity_ = capacity;
+        }
+
+        void release_() {
+            if (nodes_ == nullptr || allocator_.free == nullptr)
+                return;
+            if (allocator_.free_sized != nullptr)
+                allocator_.free_sized(&allocator_, nodes_, capacity_ * sizeof(rmq_node), FLAT_NODES_LINE);
+            else
+                allocator_.free(&allocator_, nodes_);
+        }
+
+        /**
+         * In key order, each step is a descent from the root
+         */
+        struct iterator {
+            const flat_rmq_map *map_;
+            rmq_node           *node_;
+
+            iterator(const flat_rmq_map *map, rmq_node *node) :
+                map_(map), node_(node) {
+            }
+
+            rmq_node &operator * () const {
+                return *node_;
+            }
+
+            iterator &operator ++ () {
+                node_ = map_->next(node_->key);
+                return *this;
+            }
+
+            bool operator != (const iterator &other) const {
+                return node_ != other.node_;
+            }
+        };
+
+        iterator begin() const {
+            return iterator(this, first());
+        }
+
+        iterator end() const {
+            return iterator(this, nullptr);
+        }
+    };
+
+}
+
+#endif //EX_LIMBO_DATA_FLAT_RMQ_MAP_H
@@ -0,0 +1,383 @@
+//
+// Created by henryco on 17/10/26.
+//
+
+#ifndef EX_LIMBO_DATA_HASH_MAP_H
+#define EX_LIMBO_DATA_HASH_MAP_H
+
+#include "array.h"
+#include <functional>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace ex::data {
+
+#define HASH_GROUP_N (16)   // control bytes probed at once
+#define HASH_EMPTY   (0x80)
+#define HASH_DELETED (0xFE) // both with the high bit set, full slots hold 7 hash bits
+
+    /**
+     * Drop-in for array_map past a few dozen keys: keys and values stay in dense arrays
+     * (same order, same index based API), an open addressing index maps keys to their positions.
+     * The index is swiss-table style: one control byte per slot holding 7 bits of the hash,
+     * probed a group of 16 at a time (SSE2 where available), so most misses never touch a key.
+     * <br/><br/>
+     * <b>remove</b> is O(1) (swap with the last entry), <b>collapse</b> keeps the order and is O(capacity).
+     */
+    template<typename key_t, typename val_t, typename hash_t = std::hash<key_t>>
+    struct hash_map {
+
+        struct entry {
+            key_t key;
+            val_t val;
+        };
+
+        array<key_t> key_entries;
+        array<val_t> val_entries;
+
+        const int &capacity = key_entries.capacity;
+        const int &size     = key_entries.size;
+
+        u_int8_t  *ctrl_    = nullptr; // slots_n_ control bytes, followed by slots_n_ dense indices
+        int32_t   *slots_   = nullptr;
+        u_int32_t  slots_n_ = 0;       // power of two, at least HASH_GROUP_N
+        u_int32_t  tombs_n_ = 0;
+
+        ~hash_map() {
+            release_();
+        }
+
+        hash_map() = default;
+
+        hash_map(const allocator &allocator_) :
+            key_entries(allocator_), val_entries(allocator_) {
+        }
+
+        hash_map(int capacity) :
+            key_entries(capacity), val_entries(capacity) {
+            rebuild_(slots_for_(capacity));
+        }
+
+        hash_map(int capacity, const allocator &allocator_) :
+            key_entries(capacity, allocator_), val_entries(capacity, allocator_) {
+            rebuild_(slots_for_(capacity));
+        }
+
+        hash_map(const hash_map &src) :
+            key_entries(src.key_entries), val_entries(src.val_entries) {
+            copy_index_(src);
+        }
+
+        hash_map(hash_map &&src) noexcept :
+            key_entries(static_cast<array<key_t> &&>(src.key_entries)),
+            val_entries(static_cast<array<val_t> &&>(src.val_entries)),
+            ctrl_(src.ctrl_), slots_(src.slots_), slots_n_(src.slots_n_), tombs_n_(src.tombs_n_) {
+            src.ctrl_    = nullptr;
+            src.slots_   = nullptr;
+            src.slots_n_ = 0;
+            src.tombs_n_ = 0;
+        }
+
+        hash_map &operator = (const hash_map &other) {
+            if (this == &other)
+                return *this;
+            release_();
+            key_entries = other.key_entries;
+            val_entries = other.val_entries;
+            copy_index_(other);
+            return *this;
+        }
+
+        hash_map &operator = (hash_map &&other) noexcept {
+            if (this == &other)
+                return *this;
+            release_();
+            key_entries = static_cast<array<key_t> &&>(other.key_entries);
+            val_entries = static_cast<array<val_t> &&>(other.val_entries);
+            ctrl_       = other.ctrl_;
+            slots_      = other.slots_;
+            slots_n_    = other.slots_n_;
+            tombs_n_    = other.tombs_n_;
+
+            other.ctrl_    = nullptr;
+            other.slots_   = nullptr;
+            other.slots_n_ = 0;
+            other.tombs_n_ = 0;
+            return *this;
+        }
+
+        void put(const entry &entry) {
+            put(entry.key, entry.val);
+        }
+
+        void put(const key_t &key, const val_t &element) {
+            const u_int64_t hash = hash_(key);
+            if (const int32_t slot = find_(key, hash); slot >= 0) {
+                val_entries[slots_[slot]] = element;
+                return;
+            }
+            insert_(key, hash);
+            val_entries.push(element);
+        }
+
+        val_t &operator [] (const key_t &key) {
+            const u_int64_t hash = hash_(key);
+            if (const int32_t slot = find_(key, hash); slot >= 0)
+                return val_entries[slots_[slot]];
+            insert_(key, hash);
+            val_entries.push(val_t());
+            return val_entries[val_entries.size - 1];
+        }
+
+        const val_t &operator [] (const key_t &key) const {
+            return at(key);
+        }
+
+        int index_at(const key_t &key) const {
+            const int32_t slot = find_(key, hash_(key));
+            if (slot < 0)
+                abort();
+            return slots_[slot];
+        }
+
+        val_t &at(const key_t &key) {
+            return val_entries[index_at(key)];
+        }
+
+        const val_t &at(const key_t &key) const {
+            return val_entries[index_at(key)];
+        }
+
+        const val_t &at_index(const int &index) const {
+            return val_entries[index];
+        }
+
+        val_t &at_index(const int &index) {
+            return val_entries[index];
+        }
+
+        val_t at_or_default(const key_t &key, const val_t &default_value = val_t()) const {
+            const int32_t slot = find_(key, hash_(key));
+            return slot >= 0 ? val_entries[slots_[slot]] : default_value;
+        }
+
+        bool contains(const key_t &key) const {
+            return find_(key, hash_(key)) >= 0;
+        }
+
+        void remove(const key_t &key) {
+            if (const int32_t slot = find_(key, hash_(key)); slot >= 0)
+                remove_slot_(slot);
+        }
+
+        void collapse(const key_t &key) {
+            if (const int32_t slot = find_(key, hash_(key)); slot >= 0)
+                collapse_slot_(slot);
+        }
+
+        void remove_at_pos(const int &idx) {
+            if (idx >= key_entries.size || idx < 0)
+                return;
+            remove_slot_(find_(key_entries[idx], hash_(key_entries[idx])));
+        }
+
+        void collapse_at_pos(const int &idx) {
+            if (idx >= key_entries.size || idx < 0)
+                return;
+            collapse_slot_(find_(key_entries[idx], hash_(key_entries[idx])));
+        }
+
+        bool empty() const {
+            return size <= 0;
+        }
+
+        void clean() {
+            release_();
+            key_entries.clean();
+            val_entries.clean();
+        }
+
+        void reserve(const int n) {
+            if (n <= capacity)
+                return;
+            key_entries.reserve(n);
+            val_entries.reserve(n);
+            if (slots_for_(n) > slots_n_)
+                rebuild_(slots_for_(n));
+        }
+
+        // =========================================== INTERNAL UTILS ==================================================
+
+        static u_int64_t hash_(const key_t &key) {
+            u_int64_t h = static_cast<u_int64_t>(hash_t{}(key)); // std::hash of integers is the identity, mix it
+            h ^= h >> 33;
+            h *= 0xFF51AFD7ED558CCDULL;
+            h ^= h >> 33;
+            return h;
+        }
+
+        /**
+         * Smallest table keeping <b>n</b> keys under 7/8 load
+         */
+        static u_int32_t slots_for_(const int n) {
+            u_int32_t slots_n = HASH_GROUP_N;
+            while (static_cast<u_int64_t>(n) * 8 > static_cast<u_int64_t>(slots_n) * 7)
+                slots_n *= 2;
+            return slots_n;
+        }
+
+        /**
+         * Bit i set when control byte i of the group equals <b>byte</b>
+         */
+        static u_int32_t match_(const u_int8_t *group, const u_int8_t byte) {
+            #if defined(__SSE2__)
+            const __m128i ctrl = _mm_load_si128(reinterpret_cast<const __m128i *>(group));
+            return static_cast<u_int32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(ctrl, _mm_set1_epi8(static_cast<char>(byte)))));
+            #else
+            u_int32_t bits = 0;
+            for (int i = 0; i < HASH_GROUP_N; ++i)
+                bits |= static_cast<u_int32_t>(group[i] == byte) << i;
+            return bits;
+            #endif
+        }
+
+        /**
+         * Bit i set when slot i of the group is empty or deleted (high bit of the control byte)
+         */
+        static u_int32_t match_free_(const u_int8_t *group) {
+            #if defined(__SSE2__)
+            return static_cast<u_int32_t>(_mm_movemask_epi8(_mm_load_si128(reinterpret_cast<const __m128i *>(group))));
+            #else
+            u_int32_t bits = 0;
+            for (int i = 0; i < HASH_GROUP_N; ++i)
+                bits |= static_cast<u_int32_t>(group[i] >> 7) << i;
+            return bits;
+            #endif
+        }
+
+        /**
+         * Slot of the key or -1. Groups are probed triangularly, which visits every group of a power of two table
+         */
+        int32_t find_(const key_t &key, const u_int64_t hash) const {
+            if (slots_n_ == 0)
+                return -1;
+            const u_int32_t mask = slots_n_ / HASH_GROUP_N - 1;
+            const u_int8_t  h2   = static_cast<u_int8_t>(hash & 0x7F);
+            for (u_int32_t group = static_cast<u_int32_t>(hash >> 7) & mask, step = 0;; group = (group + ++step) & mask) {
+                const u_int8_t *ctrl = ctrl_ + group * HASH_GROUP_N;
+                for (u_int32_t bits = match_(ctrl, h2); bits != 0; bits &= bits - 1) {
+                    const int32_t slot = static_cast<int32_t>(group * HASH_GROUP_N + __builtin_ctz(bits));
+                    if (key_entries[slots_[slot]] == key)
+                        return slot;
+                }
+                if (match_(ctrl, HASH_EMPTY) != 0 || step > mask)
+                    return -1;
+            }
+        }
+
+        u_int32_t free_slot_(const u_int64_t hash) const {
+            const u_int32_t mask = slots_n_ / HASH_GROUP_N - 1;
+            for (u_int32_t group = static_cast<u_int32_t>(hash >> 7) & mask, step = 0;; group = (group + ++step) & mask) {
+                if (const u_int32_t bits = match_free_(ctrl_ + group * HASH_GROUP_N); bits != 0)
+                    return group * HASH_GROUP_N + __builtin_ctz(bits);
+            }
+        }
+
+        /**
+         * Indexes the key at the next dense position and pushes it, the caller pushes the value
+         */
+        void insert_(const key_t &key, const u_int64_t hash) {
+            if (static_cast<u_int64_t>(size + 1 + tombs_n_) * 8 > static_cast<u_int64_t>(slots_n_) * 7) {
+                const u_int32_t slots_n = slots_for_(size + 1);
+                rebuild_(slots_n > slots_n_ ? slots_n : slots_n_); // same size just drops the tombstones
+            }
+
+            const u_int32_t slot = free_slot_(hash);
+            tombs_n_ -= (ctrl_[slot] == HASH_DELETED);
+            ctrl_[slot]  = static_cast<u_int8_t>(hash & 0x7F);
+            slots_[slot] = size;
+            key_entries.push(key);
+        }
+
+        void remove_slot_(const int32_t slot) {
+            const int32_t index = slots_[slot];
+            const int32_t last  = size - 1;
+            ctrl_[slot] = HASH_DELETED;
+            tombs_n_++;
+            if (index != last)
+                slots_[find_(key_entries[last], hash_(key_entries[last]))] = index;
+            key_entries.swap_remove(index);
+            val_entries.swap_remove(index);
+        }
+
+        void collapse_slot_(const int32_t slot) {
+            const int32_t index = slots_[slot];
+            ctrl_[slot] = HASH_DELETED;
+            tombs_n_++;
+            for (u_int32_t i = 0; i < slots_n_; ++i)
+                if ((ctrl_[i] & 0x80) == 0 && slots_[i] > index)
+                    slots_[i]--;
+            key_entries.collapse(index);
+            val_entries.collapse(index);
+        }
+
+        /**
+         * New table of <b>slots_n</b> slots, indexed again from the dense arrays (drops tombstones)
+         */
+        void rebuild_(const u_int32_t slots_n) {
+            allocator &allocator = key_entries.allocator_;
+            if (slots_n != slots_n_) {
+                free_table_();
+                ctrl_    = static_cast<u_int8_t *>(allocator.malloc(&allocator, table_bytes_(slots_n), HASH_GROUP_N));
+                slots_   = reinterpret_cast<int32_t *>(ctrl_ + slots_n);
+                slots_n_ = slots_n;
+            }
+            ::memset(ctrl_, HASH_EMPTY, slots_n_);
+            tombs_n_ = 0;
+            for (int i = 0; i < size; ++i) {
+                const u_int64_t hash = hash_(key_entries[i]);
+                const u_int32_t slot = free_slot_(hash);
+                ctrl_[slot]  = static_cast<u_int8_t>(hash & 0x7F);
+                slots_[slot] = i;
+            }
+        }
+
+        void copy_index_(const hash_map &src) {
+            if (src.slots_n_ == 0)
+                return;
+            allocator &allocator = key_entries.allocator_;
+            ctrl_    = static_cast<u_int8_t *>(allocator.malloc(&allocator, table_bytes_(src.slots_n_), HASH_GROUP_N));
+            slots_   = reinterpret_cast<int32_t *>(ctrl_ + src.slots_n_);
+            slots_n_ = src.slots_n_;
+            tombs_n_ = src.tombs_n_;
+            ::memcpy(ctrl_, src.ctrl_, table_bytes_(slots_n_));
+        }
+
+        static std::size_t table_bytes_(const u_int32_t slots_n) {
+            return static_cast<std::size_t>(slots_n) * (1 + sizeof(int32_t));
+        }
+
+        void free_table_() {
+            allocator &allocator = key_entries.allocator_;
+            if (ctrl_ != nullptr && allocator.free != nullptr) {
+                if (allocator.free_sized != nullptr)
+                    allocator.free_sized(&allocator, ctrl_, table_bytes_(slots_n_), HASH_GROUP_N);
+                else
+                    allocator.free(&allocator, ctrl_);
+            }
+            ctrl_  = nullptr;
+            slots_ = nullptr;
+        }
+
+        void release_() {
+            free_table_();
+            slots_n_ = 0;
+            tombs_n_ = 0;
+        }
+    };
+
+}
+
+#endif //EX_LIMBO_DATA_HASH_MAP_H
@@ -6,10 +6,30 @@
 #define EX_LIMBO_DATA_LIST_MAP_H
 
 #include "../alloc/datalloc.h"
+#include "../alloc/nodepool.h"
+#include "array.h"
+#include <barrier>
+#include <cstring>
 #include <new>
+#include <thread>
+#include <type_traits>
 
 namespace ex::data {
 
+// -----------------------------
+#ifndef LIST_SORT_THREADS
+#define LIST_SORT_THREADS (4)       // default workers of sort_parallel()
+#endif
+
+#ifndef LIST_SORT_RUN_MIN
+#define LIST_SORT_RUN_MIN (1 << 15) // fewer nodes per worker than this and sort_parallel() uses less workers
+#endif
+
+#ifndef LIST_SORT_BLOCK
+#define LIST_SORT_BLOCK (32)        // insertion sorted blocks the gathered merge sort starts from
+#endif
+// -----------------------------
+
     /**
      * Linked-list backed implementation of Map
      */
@@ -40,6 +60,8 @@ namespace ex::data {
         list_node    *root_;
         list_node    *back_;
 
+        nodepool::allocator *pool_ = nullptr; // use_pool()
+
         list_map():
             comp_(&list_map::default_comparator), size_(0), root_(nullptr), back_(nullptr) {
         }
@@ -59,17 +81,23 @@ namespace ex::data {
         }
 
         list_map(const list_map &other) {
-            allocator_ = other.allocator_;
+            root_      = nullptr;
+            allocator_ = other.upstream_();
             comp_      = other.comp_;
-            full_copy_(other.root_, &size_, &root_, &back_);
+            if (other.pool_ != nullptr)
+                use_pool();
+            full_copy_(other.root_, other.size_, &size_, &root_, &back_);
         }
 
         list_map(list_map &&other) noexcept {
             allocator_  = other.allocator_;
+            pool_       = other.pool_;
             comp_       = other.comp_;
             root_       = other.root_;
             back_       = other.back_;
             size_       = other.size_;
+            other.allocator_ = other.upstream_();
+            other.pool_ = nullptr;
             other.root_ = nullptr;
             other.back_ = nullptr;
             other.size_ = 0;
@@ -80,10 +108,13 @@ namespace ex::data {
                 return *this;
 
             clean();
+            drop_pool_();
 
-            allocator_ = other.allocator_;
+            allocator_ = other.upstream_();
             comp_      = other.comp_;
-            full_copy_(other.root_, &size_, &root_, &back_);
+            if (other.pool_ != nullptr)
+                use_pool();
+            full_copy_(other.root_, other.size_, &size_, &root_, &back_);
 
             return *this;
         }
@@ -93,12 +124,16 @@ namespace ex::data {
                 return *this;
 
             clean();
+            drop_pool_();
 
             allocator_  = other.allocator_;
+            pool_       = other.pool_;
             comp_       = other.comp_;
             root_       = other.root_;
             back_       = other.back_;
             size_       = other.size_;
+            other.allocator_ = other.upstream_();
+            other.pool_ = nullptr;
             other.root_ = nullptr;
             other.back_ = nullptr;
             other.size_ = 0;
@@ -107,24 +142,37 @@ namespace ex::data {
         }
 
         ~list_map() {
-            for (list_node *head = root_; head != nullptr;) {
-                list_node *next = head->next;
-                release_node_(head);
-                head = next;
-            }
+            clean();
+            drop_pool_();
         }
 
         void clean() {
-            for (list_node *head = root_; head != nullptr;) {
-                list_node *next = head->next;
-                release_node_(head);
-                head = next;
-            }
+            if (pool_ != nullptr && std::is_trivially_destructible_v<list_node>)
+                pool_->reset(); // nothing to destruct, every node goes at once
+            else
+                release_all_(root_);
             root_ = nullptr;
             back_ = nullptr;
             size_ = 0;
         }
 
+        /**
+         * Nodes of this map come from its own chunked pool from now on (nodepool::allocator over the current allocator),
+         * they sit close together and clean() drops them at once. The map has to be empty
+         */
+        void use_pool() {
+            if (pool_ != nullptr)
+                return;
+            if (root_ != nullptr)
+                abort_("Node pool can only be attached to an empty map");
+            pool_      = new (malloc_<nodepool::allocator>(this, allocator_, 1)) nodepool::allocator(allocator_, sizeof(list_node), alignof(list_node));
+            allocator_ = pool_->compat();
+        }
+
+        bool pooled() const {
+            return pool_ != nullptr;
+        }
+
         bool empty() const {
             return size_ == 0;
         }
@@ -448,6 +496,48 @@ namespace ex::data {
             sort_(compare);
         }
 
+        /**
+         * Same order as sort(), but the nodes are gathered into a contiguous array first (keys copied along when
+         * they are small and trivially copyable), merge sorted there and relinked in one pass.
+         * Needs two arrays of <b>size()</b> items from the allocator (upstream one when pooled)
+         */
+        void sort_gather() {
+            sort_parallel(1);
+        }
+
+        void sort_gather(const sort_compare_fn compare) {
+            sort_parallel(compare, 1);
+        }
+
+        /**
+         * sort_gather() split between <b>threads_n</b> workers: each sorts its own run, runs are merged pairwise
+         * with every worker taking an equal slice of each merge, relinking is split the same way.
+         * Workers are started for the call and joined before it returns, small lists get less of them
+         * (see LIST_SORT_RUN_MIN). The comparator is called concurrently
+         */
+        void sort_parallel(const int threads_n = LIST_SORT_THREADS) {
+            if constexpr (key_items_) {
+                if (comp_ == &default_comparator)
+                    gather_sort_<key_item_>([](const key_item_ &a, const key_item_ &b) -> int8_t {
+                        return (a.key > b.key) - (a.key < b.key);
+                    }, threads_n);
+                else
+                    gather_sort_<key_item_>([f = comp_](const key_item_ &a, const key_item_ &b) -> int8_t {
+                        return f(&a.key, &b.key);
+                    }, threads_n);
+            } else {
+                gather_sort_<node_item_>([f = comp_](const node_item_ &a, const node_item_ &b) -> int8_t {
+                    return f(&(a.node->key), &(b.node->key));
+                }, threads_n);
+            }
+        }
+
+        void sort_parallel(const sort_compare_fn compare, const int threads_n = LIST_SORT_THREADS) {
+            gather_sort_<node_item_>([compare](const node_item_ &a, const node_item_ &b) -> int8_t {
+                return compare(a.node, b.node);
+            }, threads_n);
+        }
+
         template<typename F>
         void sort_(const F fn) {
             root_ = merge_sort_(fn, root_);
@@ -459,6 +549,175 @@ namespace ex::data {
             }
         }
 
+        // =========================================== INTERNAL UTILS ==================================================
+
+        struct node_item_ {
+            list_node *node;
+        };
+
+        struct key_item_ {
+            key_t      key;
+            list_node *node;
+        };
+
+        /**
+         * Keys worth copying next to the node pointer, comparisons then never touch the nodes
+         */
+        static constexpr bool key_items_ = std::is_trivially_copyable_v<key_t> && sizeof(key_t) <= 16;
+
+        template<typename item_t, typename F>
+        void gather_sort_(const F fn, int threads_n) {
+            const int64_t n = size_;
+            if (n < 2)
+                return;
+
+            const int64_t max_n = n / LIST_SORT_RUN_MIN;
+            if (threads_n > max_n)
+                threads_n = max_n < 1 ? 1 : static_cast<int>(max_n);
+            if (threads_n < 1)
+                threads_n = 1;
+
+            allocator upstream = upstream_();
+            item_t   *items    = malloc_<item_t>(this, upstream, n);
+            item_t   *buffer   = malloc_<item_t>(this, upstream, n);
+
+            int64_t i = 0;
+            for (list_node *head = root_; head != nullptr; head = head->next) {
+                if constexpr (std::is_same_v<item_t, key_item_>)
+                    items[i++] = { head->key, head };
+                else
+                    items[i++] = { head };
+            }
+
+            array<int64_t, LIST_SORT_THREADS + 1> bounds(threads_n + 1, upstream); // run w is [bounds[w], bounds[w + 1])
+            for (int w = 0; w <= threads_n; ++w)
+                bounds.push(n * w / threads_n);
+
+            item_t *sorted = items;
+            if (threads_n == 1) {
+                sorted = sort_items_(fn, items, buffer, n);
+                relink_(sorted, 0, n, n);
+            } else {
+                std::barrier sync(threads_n);
+                auto work = [&](const int w) {
+                    const int64_t lo = bounds[w];
+                    if (item_t *run = sort_items_(fn, items + lo, buffer + lo, bounds[w + 1] - lo); run != items + lo)
+                        ::memcpy(items + lo, run, (bounds[w + 1] - lo) * sizeof(item_t));
+                    sync.arrive_and_wait();
+
+                    item_t *src = items;
+                    item_t *dst = buffer;
+                    for (int span = 1; span < threads_n; span *= 2) {
+                        // pair of runs merged by workers [first, last)
+                        const int     first = w - w % (2 * span);
+                        const int     last  = first + 2 * span < threads_n ? first + 2 * span : threads_n;
+                        const int     mid   = first + span < threads_n ? first + span : threads_n;
+                        const int64_t a_lo  = bounds[first], b_lo = bounds[mid], b_hi = bounds[last];
+                        const int64_t out_n = b_hi - a_lo;
+                        const int64_t k0    = out_n * (w - first) / (last - first);
+                        const int64_t k1    = out_n * (w - first + 1) / (last - first);
+                        merge_slice_(fn, src + a_lo, b_lo - a_lo, src + b_lo, b_hi - b_lo, dst + a_lo, k0, k1);
+                        sync.arrive_and_wait();
+
+                        item_t *tmp = src;
+                        src = dst;
+                        dst = tmp;
+                    }
+
+                    relink_(src, lo, bounds[w + 1], n);
+                    if (w == 0)
+                        sorted = src;
+                };
+
+                array<std::thread, LIST_SORT_THREADS> workers(threads_n - 1, upstream);
+                for (int w = 1; w < threads_n; ++w)
+                    workers.emplace_back(work, w);
+                work(0);
+                for (int w = 0; w < workers.size; ++w)
+                    workers[w].join();
+            }
+
+            root_ = sorted[0].node;
+            back_ = sorted[n - 1].node;
+
+            free_(this, upstream, items);
+            free_(this, upstream, buffer);
+        }
+
+        /**
+         * Stable bottom-up merge sort of [items, items + n) from insertion sorted blocks, ping-pongs with
+         * <b>buffer</b>, returns whichever of the two ends up holding the result
+         */
+        template<typename item_t, typename F>
+        static item_t *sort_items_(const F fn, item_t *items, item_t *buffer, const int64_t n) {
+            for (int64_t lo = 0; lo < n; lo += LIST_SORT_BLOCK) {
+                const int64_t hi = lo + LIST_SORT_BLOCK < n ? lo + LIST_SORT_BLOCK : n;
+                for (int64_t i = lo + 1; i < hi; ++i) {
+                    const item_t item = items[i];
+                    int64_t      j    = i;
+                    for (; j > lo && fn(items[j - 1], item) > 0; --j)
+                        items[j] = items[j - 1];
+                    items[j] = item;
+                }
+            }
+
+            item_t *src = items;
+            item_t *dst = buffer;
+            for (int64_t width = LIST_SORT_BLOCK; width < n; width *= 2) {
+                for (int64_t lo = 0; lo < n; lo += 2 * width) {
+                    const int64_t mid = lo + width < n ? lo + width : n;
+                    const int64_t hi  = lo + 2 * width < n ? lo + 2 * width : n;
+                    merge_slice_(fn, src + lo, mid - lo, src + mid, hi - mid, dst + lo, 0, hi - lo);
+                }
+                item_t *tmp = src;
+                src = dst;
+                dst = tmp;
+            }
+            return src;
+        }
+
+        /**
+         * Writes outputs [k0, k1) of the stable merge of <b>a</b> and <b>b</b> (ties go to <b>a</b>) to out + k0,
+         * the starting point is found by a binary search along the merge path, so slices merge independently
+         */
+        template<typename item_t, typename F>
+        static void merge_slice_(const F fn, const item_t *a, const int64_t a_n, const item_t *b, const int64_t b_n,
+                                 item_t *out, const int64_t k0, const int64_t k1) {
+            int64_t i = merge_path_(fn, a, a_n, b, b_n, k0);
+            int64_t j = k0 - i;
+            for (int64_t k = k0; k < k1; ++k) {
+                if (j >= b_n || (i < a_n && fn(a[i], b[j]) <= 0))
+                    out[k] = a[i++];
+                else
+                    out[k] = b[j++];
+            }
+        }
+
+        /**
+         * Number of items taken from <b>a</b> within the first <b>k</b> outputs of the merge
+         */
+        template<typename item_t, typename F>
+        static int64_t merge_path_(const F fn, const item_t *a, const int64_t a_n, const item_t *b, const int64_t b_n,
+                                   const int64_t k) {
+            int64_t lo = k > b_n ? k - b_n : 0;
+            int64_t hi = k < a_n ? k : a_n;
+            while (lo < hi) {
+                const int64_t i = (lo + hi) / 2;
+                if (fn(a[i], b[k - i - 1]) <= 0) lo = i + 1;
+                else                             hi = i;
+            }
+            return lo;
+        }
+
+        template<typename item_t>
+        static void relink_(const item_t *items, const int64_t lo, const int64_t hi, const int64_t n) {
+            for (int64_t i = lo; i < hi; ++i) {
+                list_node *node = items[i].node;
+                node->prev      = i > 0 ? items[i - 1].node : nullptr;
+                node->next      = i + 1 < n ? items[i + 1].node : nullptr;
+            }
+        }
+
         // ---------------------------------------- GPT GENERATED BULLSHIT ---------------------------------------------
         // Iterative version of my (recurrent) merge sort
         template<typename F>
@@ -621,6 +880,23 @@ namespace ex::data {
 //        }
         // -------------------------------------------------------------------------------------------------------------
 
+        /**
+         * Allocator behind the pool (or the one in use)
+         */
+        allocator upstream_() const {
+            return pool_ != nullptr ? pool_->upstream_ : allocator_;
+        }
+
+        void drop_pool_() {
+            if (pool_ == nullptr)
+                return;
+            allocator upstream = pool_->upstream_;
+            pool_->~allocator();
+            free_(this, upstream, pool_);
+            allocator_ = upstream;
+            pool_      = nullptr;
+        }
+
         list_node *instance_node_() {
             return new (malloc_<list_node>(this, allocator_, 1)) list_node;
         }
@@ -632,35 +908,47 @@ namespace ex::data {
             free_(this, allocator_, node);
         }
 
-        list_node *copy_node_(const list_node *node) {
-            if (node == nullptr)
-                return nullptr;
-            list_node *copy = instance_node_();
-            copy->prev      = node->prev;
-            copy->next      = node->next;
+        list_node *copy_node_(alloc_batch &batch, const list_node *node) {
+            list_node *copy = new (batch.take()) list_node;
+            copy->prev      = nullptr;
+            copy->next      = nullptr;
             copy->key       = node->key;
             copy->val       = node->val;
             return copy;
         }
 
-        void full_copy_(const list_node *node, int64_t *size, list_node **root, list_node **back) {
-            if (node == nullptr) {
-                *size = 0;
-                *root = nullptr;
-                *back = nullptr;
+        /**
+         * Nodes for the whole list are taken from the allocator in batches
+         */
+        void full_copy_(const list_node *node, const int64_t size_n, int64_t *size, list_node **root, list_node **back) {
+            *size = 0;
+            *root = nullptr;
+            *back = nullptr;
+            if (node == nullptr)
                 return;
+
+            alloc_batch batch(allocator_, sizeof(list_node), alignof(list_node), size_n);
+
+            for (list_node *tail = nullptr; node != nullptr; node = node->next) {
+                list_node *copy = copy_node_(batch, node);
+                copy->prev      = tail;
+                if (tail != nullptr)
+                    tail->next = copy;
+                else
+                    *root = copy;
+                tail  = copy;
+                *back = copy;
+                (*size)++;
             }
+        }
 
-            *size = 1;
-            *root = copy_node_(node);
-            for (list_node *head = *root; head != nullptr; head = head->next) {
-                if (list_node *next = head->next; next != nullptr) {
-                    list_node *copy = copy_node_(next);
-                    copy->prev      = head;
-                    head->next      = copy;
-                    *back           = copy;
-                    (*size)++;
-                }
+        void release_all_(list_node *node) {
+            alloc_batch batch(allocator_, sizeof(list_node), alignof(list_node));
+            for (list_node *head = node; head != nullptr;) {
+                list_node *next = head->next;
+                head->~list_node();
+                batch.put(head);
+                head = next;
             }
         }
 
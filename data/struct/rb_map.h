@@ -6,15 +6,20 @@
 #define EX_LIMBO_DATA_RB_MAP_H
 
 #include "../alloc/datalloc.h"
+#include "../alloc/nodepool.h"
 #include <cstring>
 #include <new>
+#include <type_traits>
 
 namespace ex::data {
 
     /**
      * Red-Black Tree implementation of Map
+     * <br/><br/>
+     * <b>ranked = true</b> keeps subtree sizes in the nodes: select(k), rank(key) and count(lo, hi) in O(log n).
+     * Plain maps carry no counter
      */
-    template<typename key_t, typename val_t>
+    template<typename key_t, typename val_t, bool ranked = false>
     struct rb_map {
 
         struct entry {
@@ -26,7 +31,12 @@ namespace ex::data {
 #define BLACK_        false
 #define RED_          true
 
-        struct rb_node {
+        struct rank_none_ {};
+        struct rank_cnt_ {
+            int64_t cnt;
+        };
+
+        struct rb_node : std::conditional_t<ranked, rank_cnt_, rank_none_> {
             rb_node *par;
             rb_node *lns;
             rb_node *rns;
@@ -51,6 +61,8 @@ namespace ex::data {
         int64_t       size_;
         rb_node      *root_;
 
+        nodepool::allocator *pool_ = nullptr; // use_pool()
+
         rb_map():
             comp_(&rb_map::default_comparator), size_(0), root_(nullptr) {
         }
@@ -71,23 +83,32 @@ namespace ex::data {
 
         rb_map(const rb_map &other):
             comp_(other.comp_), size_(other.size_) {
-            root_      = other.iterative_copy_(other.root_);
-            allocator_ = other.allocator_;
+            root_      = nullptr;
+            allocator_ = other.upstream_();
+            if (other.pool_ != nullptr)
+                use_pool();
+            root_      = iterative_copy_(other.root_, other.size_);
         }
 
         rb_map(rb_map &&other) noexcept:
             comp_(other.comp_), size_(other.size_), root_(other.root_) {
-            allocator_ = other.allocator_;
-            other.root_ = nullptr;
-            other.size_ = 0;
+            allocator_       = other.allocator_;
+            pool_            = other.pool_;
+            other.allocator_ = other.upstream_();
+            other.pool_      = nullptr;
+            other.root_      = nullptr;
+            other.size_      = 0;
         }
 
         rb_map &operator = (const rb_map &other) {
             if (this == &other)
                 return *this;
             clean();
-            root_      = other.iterative_copy_(other.root_);
-            allocator_ = other.allocator_;
+            drop_pool_();
+            allocator_ = other.upstream_();
+            if (other.pool_ != nullptr)
+                use_pool();
+            root_      = iterative_copy_(other.root_, other.size_);
             comp_      = other.comp_;
             size_      = other.size_;
             return *this;
@@ -97,7 +118,11 @@ namespace ex::data {
             if (this == &other)
                 return *this;
             clean();
-            allocator_ = other.allocator_;
+            drop_pool_();
+            allocator_       = other.allocator_;
+            pool_            = other.pool_;
+            other.allocator_ = other.upstream_();
+            other.pool_      = nullptr;
             comp_      = other.comp_;
             size_      = other.size_;
             root_      = other.root_;
@@ -107,16 +132,36 @@ namespace ex::data {
         }
 
         ~rb_map() {
-            iterative_free_(root_);
-            root_ = nullptr;
+            clean();
+            drop_pool_();
         }
 
         void clean() {
-            iterative_free_(root_);
+            if (pool_ != nullptr && std::is_trivially_destructible_v<rb_node>)
+                pool_->reset(); // nothing to destruct, every node goes at once
+            else
+                iterative_free_(root_);
             root_ = nullptr;
             size_ = 0;
         }
 
+        /**
+         * Nodes of this map come from its own chunked pool from now on (nodepool::allocator over the current allocator),
+         * they sit close together and clean() drops them at once. The map has to be empty
+         */
+        void use_pool() {
+            if (pool_ != nullptr)
+                return;
+            if (root_ != nullptr)
+                abort_("Node pool can only be attached to an empty map");
+            pool_      = new (malloc_<nodepool::allocator>(this, allocator_, 1)) nodepool::allocator(allocator_, sizeof(rb_node), alignof(rb_node));
+            allocator_ = pool_->compat();
+        }
+
+        bool pooled() const {
+            return pool_ != nullptr;
+        }
+
         bool empty() const {
             return size_ <= 0;
         }
@@ -229,6 +274,7 @@ namespace ex::data {
                 root_->val = val_t();
                 root_->key = key;
                 root_->col = BLACK_;
+                count_update_(root_);
                 ++size_;
                 return root_->val;
             }
@@ -257,6 +303,7 @@ namespace ex::data {
             if (direction >= 0) base->rns = node;
             else                base->lns = node;
 
+            count_insert_(node);
             fix_insert_if_needed_(node);
 
             root_->col = BLACK_; // just in case
@@ -281,6 +328,7 @@ namespace ex::data {
                 root_->val = val;
                 root_->key = key;
                 root_->col = BLACK_;
+                count_update_(root_);
                 ++size_;
                 return;
             }
@@ -313,12 +361,109 @@ namespace ex::data {
             if (direction >= 0) base->rns = node;
             else                base->lns = node;
 
+            count_insert_(node);
             fix_insert_if_needed_(node);
 
             // if root_ is nullptr we have much bigger problem
             root_->col = BLACK_; // just in case
         }
 
+        /**
+         * Replaces the content with <b>n</b> entries in strictly ascending key order, O(n) instead of n puts.
+         * <br/>
+         * Median split bottom-up: the complete levels are black, the last (partial) level is red.
+         * All nodes are taken from the allocator in one batch
+         */
+        void build_sorted(const entry *entries, const int64_t n) {
+            for (int64_t i = 1; i < n; ++i)
+                if (comp_(&(entries[i - 1].key), &(entries[i].key)) >= 0)
+                    abort_("");
+
+            clean();
+            if (n <= 0)
+                return;
+
+            alloc_batch batch(allocator_, sizeof(rb_node), alignof(rb_node), n);
+            root_ = build_(batch, entries, 0, n, nullptr, 0, full_levels_(n));
+            size_ = n;
+        }
+
+        /**
+         * First node with key not less than <b>key</b> or nullptr
+         */
+        rb_node *lower_bound(const key_t &key) const {
+            rb_node *found = nullptr;
+            for (rb_node *head = root_; head != nullptr;) {
+                if (comp_(&(head->key), &key) >= 0) {
+                    found = head;
+                    head  = head->lns;
+                }
+                else head = head->rns;
+            }
+            return found;
+        }
+
+        /**
+         * First node with key greater than <b>key</b> or nullptr
+         */
+        rb_node *upper_bound(const key_t &key) const {
+            rb_node *found = nullptr;
+            for (rb_node *head = root_; head != nullptr;) {
+                if (comp_(&(head->key), &key) > 0) {
+                    found = head;
+                    head  = head->lns;
+                }
+                else head = head->rns;
+            }
+            return found;
+        }
+
+        /**
+         * k-th smallest node (from 0) or nullptr
+         */
+        rb_node *select(int64_t k) const {
+            static_assert(ranked, "select() needs rb_map<key_t, val_t, true>");
+            if (k < 0 || k >= size_)
+                return nullptr;
+            rb_node *head = root_;
+            while (head != nullptr) {
+                const int64_t left_n = count_(head->lns);
+                if (k == left_n)
+                    return head;
+                if (k < left_n)
+                    head = head->lns;
+                else {
+                    k   -= left_n + 1;
+                    head = head->rns;
+                }
+            }
+            return nullptr;
+        }
+
+        /**
+         * Number of keys less than <b>key</b>, the key itself does not have to be present
+         */
+        int64_t rank(const key_t &key) const {
+            static_assert(ranked, "rank() needs rb_map<key_t, val_t, true>");
+            int64_t n = 0;
+            for (rb_node *head = root_; head != nullptr;) {
+                if (comp_(&(head->key), &key) < 0) {
+                    n   += count_(head->lns) + 1;
+                    head = head->rns;
+                }
+                else head = head->lns;
+            }
+            return n;
+        }
+
+        /**
+         * Number of keys in [lo, hi)
+         */
+        int64_t count(const key_t &lo, const key_t &hi) const {
+            const int64_t n = rank(hi) - rank(lo);
+            return n > 0 ? n : 0;
+        }
+
         void remove(const key_t &key) {
             int direction;
 
@@ -350,6 +495,7 @@ namespace ex::data {
                     return;
                 }
 
+                count_remove_(node);
                 rb_node *sibling = get_sibling_(node);
                 replace_with_child_(node, nullptr);
                 fix_delete_if_needed_(node, nullptr, sibling);
@@ -366,6 +512,7 @@ namespace ex::data {
                 node->key = largest->key;
                 node->val = largest->val;
 
+                count_remove_(largest);
                 rb_node *sibling = get_sibling_(largest);
                 replace_with_child_(largest, child);
                 fix_delete_if_needed_(largest, child, sibling);
@@ -386,6 +533,7 @@ namespace ex::data {
                     return;
                 }
 
+                count_remove_(node);
                 rb_node *sibling = get_sibling_(node);
                 replace_with_child_(node, child);
                 fix_delete_if_needed_(node, child, sibling);
@@ -406,6 +554,7 @@ namespace ex::data {
                     return;
                 }
 
+                count_remove_(node);
                 rb_node *sibling = get_sibling_(node);
                 replace_with_child_(node, child);
                 fix_delete_if_needed_(node, child, sibling);
@@ -657,6 +806,9 @@ namespace ex::data {
 
             left->rns = node;
             node->par = left;
+
+            count_update_(node);
+            count_update_(left);
         }
 
         void rotate_left_(rb_node *node) {
@@ -682,6 +834,9 @@ namespace ex::data {
 
             right->lns = node;
             node->par  = right;
+
+            count_update_(node);
+            count_update_(right);
         }
 
         void replace_with_child_(rb_node *node, rb_node *child) {
@@ -696,66 +851,128 @@ namespace ex::data {
                 child->par = node->par;
         }
 
+        rb_node *build_(alloc_batch &batch, const entry *entries, const int64_t lo, const int64_t hi, rb_node *par,
+                        const int depth, const int red_depth) {
+            if (lo >= hi)
+                return nullptr;
+            const int64_t mid = lo + (hi - lo) / 2;
+
+            rb_node *node = new (batch.take()) rb_node;
+            node->par = par;
+            node->val = entries[mid].val;
+            node->key = entries[mid].key;
+            node->col = depth >= red_depth ? RED_ : BLACK_;
+            node->lns = build_(batch, entries, lo, mid, node, depth + 1, red_depth);
+            node->rns = build_(batch, entries, mid + 1, hi, node, depth + 1, red_depth);
+            count_update_(node);
+            return node;
+        }
+
+        /**
+         * floor(log2(n + 1)), levels a median split of n nodes fills completely
+         */
+        static int full_levels_(const int64_t n) {
+            int levels = 0;
+            while ((int64_t{2} << levels) - 1 <= n)
+                ++levels;
+            return levels;
+        }
+
+        static int64_t count_(const rb_node *node) {
+            if constexpr (ranked)
+                return node != nullptr ? node->cnt : 0;
+            return 0;
+        }
+
+        static void count_update_(rb_node *node) {
+            if constexpr (ranked)
+                node->cnt = count_(node->lns) + count_(node->rns) + 1;
+        }
+
+        /**
+         * Fresh leaf, every ancestor grows by one
+         */
+        static void count_insert_(rb_node *node) {
+            if constexpr (ranked) {
+                node->cnt = 1;
+                for (rb_node *head = node->par; head != nullptr; head = head->par)
+                    ++head->cnt;
+            }
+        }
+
+        /**
+         * Node about to be unlinked, every ancestor shrinks by one
+         */
+        static void count_remove_(rb_node *node) {
+            if constexpr (ranked)
+                for (rb_node *head = node->par; head != nullptr; head = head->par)
+                    --head->cnt;
+        }
+
+        /**
+         * Allocator behind the pool (or the one in use)
+         */
+        allocator upstream_() const {
+            return pool_ != nullptr ? pool_->upstream_ : allocator_;
+        }
+
+        void drop_pool_() {
+            if (pool_ == nullptr)
+                return;
+            allocator upstream = pool_->upstream_;
+            pool_->~allocator();
+            free_(this, upstream, pool_);
+            allocator_ = upstream;
+            pool_      = nullptr;
+        }
+
         rb_node *instance_node_() {
             return new (malloc_<rb_node>(this, allocator_, 1)) rb_node;
         }
 
-        rb_node *copy_node_(const rb_node *node) const {
-            if (node == nullptr)
-                return nullptr;
-            rb_node *copy = instance_node_();
+        rb_node *copy_node_(alloc_batch &batch, const rb_node *node) {
+            rb_node *copy = new (batch.take()) rb_node;
             *copy = *node;
+            copy->lns = nullptr;
+            copy->rns = nullptr;
             return copy;
         }
 
-        void iterative_copy_(rb_node *const node) {
-            rb_node *copy = copy_node_(node);
-            rb_node *head = node;
-            rb_node *prev = node;
-            bool     down = true;
+        /**
+         * Mirrors the tree top-down, nodes for the whole tree are taken from the allocator in batches
+         */
+        rb_node *iterative_copy_(const rb_node *const node, const int64_t size_n) {
+            if (node == nullptr)
+                return nullptr;
 
-            while (head != nullptr) {
-                if (down && head->lns != nullptr) {
-                    prev = head;
-                    head = head->lns;
+            alloc_batch batch(allocator_, sizeof(rb_node), alignof(rb_node), size_n);
 
-                    *copy->lns = copy_node_(head);
+            rb_node *root = copy_node_(batch, node);
+            rb_node *copy = root;
+            root->par = nullptr;
+
+            for (const rb_node *head = node; head != nullptr;) {
+                if (head->lns != nullptr && copy->lns == nullptr) {
+                    copy->lns      = copy_node_(batch, head->lns);
+                    copy->lns->par = copy;
                     copy = copy->lns;
+                    head = head->lns;
                     continue;
                 }
 
-                if (down && head->rns != nullptr) {
-                    prev = head;
-                    head = head->rns;
-
-                    *copy->rns = copy_node_(head);
+                if (head->rns != nullptr && copy->rns == nullptr) {
+                    copy->rns      = copy_node_(batch, head->rns);
+                    copy->rns->par = copy;
                     copy = copy->rns;
-                    continue;
-                }
-
-                if (down || prev == head->rns) {
-                    prev = head;
-                    head = head->par;
-                    copy = copy->par;
-                    down = false;
-                    continue;
-                }
-
-                if (head->rns != nullptr) {
-                    prev = head;
                     head = head->rns;
-
-                    *copy->rns = copy_node_(head);
-                    copy = copy->rns;
-                    down = true;
                     continue;
                 }
 
-                prev = head;
-                head = head->par;
+                head = head == node ? nullptr : head->par;
                 copy = copy->par;
-                down = false;
             }
+
+            return root;
         }
 
         void free_node_(rb_node *node) {
@@ -770,6 +987,11 @@ namespace ex::data {
             release_node_(node);
         }
 
+        void release_node_(alloc_batch &batch, rb_node *node) {
+            node->~rb_node();
+            batch.put(node);
+        }
+
         void release_node_(rb_node *node) {
             if (node == nullptr)
                 return;
@@ -778,6 +1000,8 @@ namespace ex::data {
         }
 
         void iterative_free_(rb_node *const node) {
+            alloc_batch batch(allocator_, sizeof(rb_node), alignof(rb_node));
+
             rb_node *head = node;
             rb_node *prev = node;
             bool     down = true;
@@ -799,7 +1023,7 @@ namespace ex::data {
                     prev = head;
                     head = head->par;
                     down = false;
-                    release_node_(prev);
+                    release_node_(batch, prev);
                     continue;
                 }
 
@@ -813,7 +1037,7 @@ namespace ex::data {
                 prev = head;
                 head = head->par;
                 down = false;
-                release_node_(prev);
+                release_node_(batch, prev);
             }
         }
 
@@ -947,7 +1171,7 @@ namespace ex::data {
 
         template <typename T>
         T *malloc_(void *, allocator &allocator, const std::size_t size_n) {
-            return static_cast<T *>(allocator.malloc(&allocator, size_n * sizeof(T), sizeof(T)));
+            return static_cast<T *>(allocator.malloc(&allocator, size_n * sizeof(T), alignof(T)));
         }
 
         static void free_(void *, allocator &allocator, void *ptr) {
@@ -6,14 +6,69 @@
 #define EX_LIMBO_DATA_RMQ_MAP_H
 
 #include "../alloc/datalloc.h"
+#include "../alloc/nodepool.h"
 #include <new>
+#include <type_traits>
 
 namespace ex::data {
 
+    /**
+     * Aggregation policy of rmq_map, on top of the min/max: <b>value_t</b>, <b>identity()</b>,
+     * <b>of(key, val, rmq)</b> and an associative <b>combine(a, b)</b> (in key order, it does not have to commute)
+     */
+    struct rmq_no_agg {};
+
+    template <typename T>
+    struct rmq_sum_agg {
+        using value_t = T;
+
+        static value_t identity() {
+            return T{};
+        }
+
+        template <typename key_t, typename val_t, typename rmq_t>
+        static value_t of(const key_t &, const val_t &, const rmq_t &rmq) {
+            return static_cast<T>(rmq);
+        }
+
+        static value_t combine(const value_t &a, const value_t &b) {
+            return a + b;
+        }
+    };
+
+    struct rmq_count_agg {
+        using value_t = int64_t;
+
+        static value_t identity() {
+            return 0;
+        }
+
+        template <typename key_t, typename val_t, typename rmq_t>
+        static value_t of(const key_t &, const val_t &, const rmq_t &) {
+            return 1;
+        }
+
+        static value_t combine(const value_t &a, const value_t &b) {
+            return a + b;
+        }
+    };
+
+    template <typename agg_t>
+    struct rmq_agg_node_ {
+        typename agg_t::value_t agg;
+    };
+
+    template <>
+    struct rmq_agg_node_<rmq_no_agg> {};
+
     /**
      * Range-Min/Max-Query Tree based on top of a Red-Black Tree implementation of Map
+     * <br/><br/>
+     * <b>agg_t</b> adds a subtree aggregate next to min/max (see rmq_sum_agg), folded over a key range by aggregate().
+     * The default rmq_no_agg adds nothing to the nodes.
+     * Aggregates over <b>val</b> follow put()/range_set(), not writes through at()
      */
-    template<typename key_t, typename val_t, typename rmq_t = key_t>
+    template<typename key_t, typename val_t, typename rmq_t = key_t, typename agg_t = rmq_no_agg>
     struct rmq_map {
 
         struct entry {
@@ -34,7 +89,9 @@ namespace ex::data {
 #define BLACK_        false
 #define RED_          true
 
-        struct rmq_node {
+        static constexpr bool aggregated = !std::is_same_v<agg_t, rmq_no_agg>;
+
+        struct rmq_node : rmq_agg_node_<agg_t> {
             rmq_node *par;
             rmq_node *lns;
             rmq_node *rns;
@@ -74,6 +131,8 @@ namespace ex::data {
         int64_t       size_;
         rmq_node     *root_;
 
+        nodepool::allocator *pool_ = nullptr; // use_pool()
+
         rmq_map():
             comp_(&rmq_map::default_comparator),
             mmeq_(&rmq_map::default_min_max_eq),
@@ -130,8 +189,11 @@ namespace ex::data {
             comp_(other.comp_),
             mmeq_(other.mmeq_),
             size_(other.size_) {
-            allocator_ = other.allocator_;
-            root_      = other.iterative_copy_(other.root_);
+            root_      = nullptr;
+            allocator_ = other.upstream_();
+            if (other.pool_ != nullptr)
+                use_pool();
+            root_      = iterative_copy_(other.root_, other.size_);
         }
 
         rmq_map(rmq_map &&other) noexcept:
@@ -139,17 +201,23 @@ namespace ex::data {
             mmeq_(other.mmeq_),
             size_(other.size_),
             root_(other.root_) {
-            allocator_  = other.allocator_;
-            other.root_ = nullptr;
-            other.size_ = 0;
+            allocator_       = other.allocator_;
+            pool_            = other.pool_;
+            other.allocator_ = other.upstream_();
+            other.pool_      = nullptr;
+            other.root_      = nullptr;
+            other.size_      = 0;
         }
 
         rmq_map &operator = (const rmq_map &other) {
             if (this == &other)
                 return *this;
             clean();
-            root_      = other.iterative_copy_(other.root_);
-            allocator_ = other.allocator_;
+            drop_pool_();
+            allocator_ = other.upstream_();
+            if (other.pool_ != nullptr)
+                use_pool();
+            root_      = iterative_copy_(other.root_, other.size_);
             comp_      = other.comp_;
             mmeq_      = other.mmeq_;
             size_      = other.size_;
@@ -160,7 +228,11 @@ namespace ex::data {
             if (this == &other)
                 return *this;
             clean();
-            allocator_ = other.allocator_;
+            drop_pool_();
+            allocator_       = other.allocator_;
+            pool_            = other.pool_;
+            other.allocator_ = other.upstream_();
+            other.pool_      = nullptr;
             comp_      = other.comp_;
             mmeq_      = other.mmeq_;
             size_      = other.size_;
@@ -171,16 +243,36 @@ namespace ex::data {
         }
 
         ~rmq_map() {
-            iterative_free_(root_);
-            root_ = nullptr;
+            clean();
+            drop_pool_();
         }
 
         void clean() {
-            iterative_free_(root_);
+            if (pool_ != nullptr && std::is_trivially_destructible_v<rmq_node>)
+                pool_->reset(); // nothing to destruct, every node goes at once
+            else
+                iterative_free_(root_);
             root_ = nullptr;
             size_ = 0;
         }
 
+        /**
+         * Nodes of this map come from its own chunked pool from now on (nodepool::allocator over the current allocator),
+         * they sit close together and clean() drops them at once. The map has to be empty
+         */
+        void use_pool() {
+            if (pool_ != nullptr)
+                return;
+            if (root_ != nullptr)
+                abort_("Node pool can only be attached to an empty map");
+            pool_      = new (malloc_<nodepool::allocator>(this, allocator_, 1)) nodepool::allocator(allocator_, sizeof(rmq_node), alignof(rmq_node));
+            allocator_ = pool_->compat();
+        }
+
+        bool pooled() const {
+            return pool_ != nullptr;
+        }
+
         bool empty() const {
             return size_ <= 0;
         }
@@ -308,6 +400,8 @@ namespace ex::data {
                 root_->min = range;
                 root_->max = range;
                 root_->col = BLACK_;
+                if constexpr (aggregated)
+                    root_->agg = of_(root_);
                 ++size_;
                 return;
             }
@@ -352,6 +446,63 @@ namespace ex::data {
             root_->col = BLACK_; // just in case
         }
 
+        /**
+         * agg_t fold over the keys in [lo, hi], O(log n): the subtree aggregates hanging off the two boundary paths
+         */
+        auto aggregate(const key_t &lo, const key_t &hi) const {
+            static_assert(aggregated, "aggregate() needs an agg_t policy");
+            using value_t = typename agg_t::value_t;
+
+            const rmq_node *split = root_;
+            while (split != nullptr) {
+                if (comp_(&(split->key), &lo) < 0)      split = split->rns;
+                else if (comp_(&(split->key), &hi) > 0) split = split->lns;
+                else break;
+            }
+            if (split == nullptr)
+                return agg_t::identity();
+
+            value_t left = agg_t::identity();
+            for (const rmq_node *head = split->lns; head != nullptr;) {
+                if (comp_(&(head->key), &lo) >= 0) {
+                    left = agg_t::combine(agg_t::combine(of_(head), agg_(head->rns)), left);
+                    head = head->lns;
+                }
+                else head = head->rns;
+            }
+
+            value_t right = agg_t::identity();
+            for (const rmq_node *head = split->rns; head != nullptr;) {
+                if (comp_(&(head->key), &hi) <= 0) {
+                    right = agg_t::combine(right, agg_t::combine(agg_(head->lns), of_(head)));
+                    head  = head->rns;
+                }
+                else head = head->lns;
+            }
+
+            return agg_t::combine(left, agg_t::combine(of_(split), right));
+        }
+
+        /**
+         * Replaces the content with <b>n</b> entries in strictly ascending key order, O(n) instead of n puts.
+         * <br/>
+         * Median split bottom-up: the complete levels are black, the last (partial) level is red,
+         * min/max are folded in the same pass. All nodes are taken from the allocator in one batch
+         */
+        void build_sorted(const entry *entries, const int64_t n) {
+            for (int64_t i = 1; i < n; ++i)
+                if (comp_(&(entries[i - 1].key), &(entries[i].key)) >= 0)
+                    abort_("");
+
+            clean();
+            if (n <= 0)
+                return;
+
+            alloc_batch batch(allocator_, sizeof(rmq_node), alignof(rmq_node), n);
+            root_ = build_(batch, entries, 0, n, nullptr, 0, full_levels_(n));
+            size_ = n;
+        }
+
         /**
          * Returns replacement node or nullptr
          */
@@ -402,58 +553,82 @@ namespace ex::data {
             if (!overlap_(root_, min, max))
                 return nullptr;
 
-#define MAX_STACK_SIZE__ 64
-            rmq_node *stack_[MAX_STACK_SIZE__];
-            bool      stack_jump = false;
-            int       stack_size = 0;
-
             for (rmq_node *head = root_; head != nullptr;) {
-                if (mmeq_(&min, &(head->rmq)) <= 0 &&
-                    mmeq_(&max, &(head->rmq)) >= 0 &&
-                    (test == nullptr || test(head, test_this)))
+                if (fits_(head, min, max, test, test_this))
                     return head;
 
-                const bool overlap_l = overlap_(head->lns, min, max);
-                const bool overlap_r = overlap_(head->rns, min, max);
-
-                if (overlap_l && overlap_r) {
-                    if (stack_jump) {
-                        stack_jump = false;
-                        head = head->rns;
-                        continue;
-                    }
-
-                    if (stack_size >= MAX_STACK_SIZE__) {
-                        abort_("");
-                    }
-
-                    stack_[stack_size++] = head;
-                    head = head->lns;
-                    continue;
-                }
-
-                if (overlap_l) {
+                if (overlap_(head->lns, min, max)) {
                     head = head->lns;
                     continue;
                 }
 
-                if (overlap_r) {
+                if (overlap_(head->rns, min, max)) {
                     head = head->rns;
                     continue;
                 }
 
-                if (stack_size > 0) {
-                    stack_jump = true;
-                    head = stack_[--stack_size];
-                    continue;
+                // dead end, back to the closest ancestor entered from the left with an overlapping right side
+                for (;;) {
+                    rmq_node *parent = head->par;
+                    if (parent == nullptr)
+                        return nullptr;
+                    if (head == parent->lns && overlap_(parent->rns, min, max)) {
+                        head = parent->rns;
+                        break;
+                    }
+                    head = parent;
                 }
-
-                return nullptr;
             }
 
             return nullptr;
         }
 
+        /**
+         * Calls <b>fn(rmq_node *)</b> for every node with range value in [min, max], in key order.
+         * Subtrees whose min/max miss the interval are skipped, no stack is kept (parent links)
+         */
+        template <typename F>
+        void for_each_overlap(const rmq_t &min, const rmq_t &max, F &&fn) const {
+            for (auto it = overlap_iterator(this, min, max); it != overlap_iterator(); ++it)
+                fn(&(*it));
+        }
+
+        /**
+         * Lazy for_each_overlap: <b>for (auto &node : map.overlaps(min, max))</b>
+         */
+        auto overlaps(const rmq_t &min, const rmq_t &max) const {
+            struct overlap_range {
+                overlap_iterator first;
+
+                overlap_iterator begin() const {
+                    return first;
+                }
+
+                overlap_iterator end() const {
+                    return overlap_iterator();
+                }
+            };
+            return overlap_range { overlap_iterator(this, min, max) };
+        }
+
+        /**
+         * Same as range_fit, but returns the fitting node with the lowest key
+         */
+        rmq_node *range_fit_first(const rmq_t &min, const rmq_t &max, const range_test_fn test = nullptr, void *test_this = nullptr) const {
+            return fit_first_(root_, min, max, test, test_this);
+        }
+
+        /**
+         * Fitting node with the smallest range value, lowest key on ties.
+         * Unlike range_minimize it does not need sorted range values,
+         * but it visits every overlapping subtree until a node equal to <b>min</b> is found.
+         */
+        rmq_node *range_fit_best(const rmq_t &min, const rmq_t &max, const range_test_fn test = nullptr, void *test_this = nullptr) const {
+            rmq_node *best = nullptr;
+            fit_best_(root_, min, max, test, test_this, &best);
+            return best;
+        }
+
         rmq_node *range_min() const {
             if (root_ == nullptr)
                 return nullptr;
@@ -652,6 +827,33 @@ namespace ex::data {
             return mmeq_(&a, &b) > 0 ? a : b;
         }
 
+        bool fits_(const rmq_node *node, const rmq_t &min, const rmq_t &max, const range_test_fn test, void *test_this) const {
+            return mmeq_(&min, &(node->rmq)) <= 0 &&
+                   mmeq_(&max, &(node->rmq)) >= 0 &&
+                   (test == nullptr || test(node, test_this));
+        }
+
+        rmq_node *fit_first_(rmq_node *node, const rmq_t &min, const rmq_t &max, const range_test_fn test, void *test_this) const {
+            if (!overlap_(node, min, max))
+                return nullptr;
+            if (rmq_node *found = fit_first_(node->lns, min, max, test, test_this))
+                return found;
+            if (fits_(node, min, max, test, test_this))
+                return node;
+            return fit_first_(node->rns, min, max, test, test_this);
+        }
+
+        void fit_best_(rmq_node *node, const rmq_t &min, const rmq_t &max, const range_test_fn test, void *test_this, rmq_node **best) const {
+            if (!overlap_(node, min, max))
+                return;
+            if (*best != nullptr && mmeq_(&((*best)->rmq), &min) == 0)
+                return; // exact fit, nothing smaller left
+            fit_best_(node->lns, min, max, test, test_this, best);
+            if ((*best == nullptr || mmeq_(&(node->rmq), &((*best)->rmq)) < 0) && fits_(node, min, max, test, test_this))
+                *best = node;
+            fit_best_(node->rns, min, max, test, test_this, best);
+        }
+
         bool overlap_(const rmq_node *node, const rmq_t &min, const rmq_t &max) const {
             if (node == nullptr)
                 return false;
@@ -664,6 +866,14 @@ namespace ex::data {
                     mmeq_(&min, &(node->max)) <= 0);
         }
 
+        static auto of_(const rmq_node *node) {
+            return agg_t::of(node->key, node->val, node->rmq);
+        }
+
+        static auto agg_(const rmq_node *node) {
+            return node != nullptr ? node->agg : agg_t::identity();
+        }
+
         void update_ranges_(rmq_node *const node, const rmq_node *stop = nullptr) {
             rmq_node *head = node;
             while (head != nullptr && head != stop) {
@@ -687,6 +897,9 @@ namespace ex::data {
                 head->min = min_val_(head->rmq, min_val_(*min_l, *min_r));
                 head->max = max_val_(head->rmq, max_val_(*max_l, *max_r));
 
+                if constexpr (aggregated)
+                    head->agg = agg_t::combine(agg_t::combine(agg_(head->lns), of_(head)), agg_(head->rns));
+
                 head = head->par;
             }
         }
@@ -1066,68 +1279,99 @@ namespace ex::data {
             }
         }
 
+        rmq_node *build_(alloc_batch &batch, const entry *entries, const int64_t lo, const int64_t hi, rmq_node *par,
+                         const int depth, const int red_depth) {
+            if (lo >= hi)
+                return nullptr;
+            const int64_t mid = lo + (hi - lo) / 2;
+
+            rmq_node *node = new (batch.take()) rmq_node;
+            node->par = par;
+            node->val = entries[mid].val;
+            node->key = entries[mid].key;
+            node->rmq = entries[mid].rmq;
+            node->col = depth >= red_depth ? RED_ : BLACK_;
+            node->lns = build_(batch, entries, lo, mid, node, depth + 1, red_depth);
+            node->rns = build_(batch, entries, mid + 1, hi, node, depth + 1, red_depth);
+            update_ranges_(node, par);
+            return node;
+        }
+
+        /**
+         * floor(log2(n + 1)), levels a median split of n nodes fills completely
+         */
+        static int full_levels_(const int64_t n) {
+            int levels = 0;
+            while ((int64_t{2} << levels) - 1 <= n)
+                ++levels;
+            return levels;
+        }
+
+        /**
+         * Allocator behind the pool (or the one in use)
+         */
+        allocator upstream_() const {
+            return pool_ != nullptr ? pool_->upstream_ : allocator_;
+        }
+
+        void drop_pool_() {
+            if (pool_ == nullptr)
+                return;
+            allocator upstream = pool_->upstream_;
+            pool_->~allocator();
+            free_(this, upstream, pool_);
+            allocator_ = upstream;
+            pool_      = nullptr;
+        }
+
         rmq_node *instance_node_() {
             return new (malloc_<rmq_node>(this, allocator_, 1)) rmq_node;
         }
 
-        rmq_node *copy_node_(const rmq_node *node) const {
-            if (node == nullptr)
-                return nullptr;
-            rmq_node *copy = instance_node_();
+        rmq_node *copy_node_(alloc_batch &batch, const rmq_node *node) {
+            rmq_node *copy = new (batch.take()) rmq_node;
             *copy = *node;
+            copy->lns = nullptr;
+            copy->rns = nullptr;
             return copy;
         }
 
-        void iterative_copy_(rmq_node *const node) {
-            rmq_node *copy = copy_node_(node);
-            rmq_node *head = node;
-            rmq_node *prev = node;
-            bool     down = true;
+        /**
+         * Mirrors the tree top-down, nodes for the whole tree are taken from the allocator in batches
+         */
+        rmq_node *iterative_copy_(const rmq_node *const node, const int64_t size_n) {
+            if (node == nullptr)
+                return nullptr;
 
-            while (head != nullptr) {
-                if (down && head->lns != nullptr) {
-                    prev = head;
-                    head = head->lns;
+            alloc_batch batch(allocator_, sizeof(rmq_node), alignof(rmq_node), size_n);
+
+            rmq_node *root = copy_node_(batch, node);
+            rmq_node *copy = root;
+            root->par = nullptr;
 
-                    *copy->lns = copy_node_(head);
+            for (const rmq_node *head = node; head != nullptr;) {
+                if (head->lns != nullptr && copy->lns == nullptr) {
+                    copy->lns      = copy_node_(batch, head->lns);
+                    copy->lns->par = copy;
                     copy = copy->lns;
+                    head = head->lns;
                     continue;
                 }
 
-                if (down && head->rns != nullptr) {
-                    prev = head;
-                    head = head->rns;
-
-                    *copy->rns = copy_node_(head);
+                if (head->rns != nullptr && copy->rns == nullptr) {
+                    copy->rns      = copy_node_(batch, head->rns);
+                    copy->rns->par = copy;
                     copy = copy->rns;
-                    continue;
-                }
-
-                if (down || prev == head->rns) {
-                    prev = head;
-                    head = head->par;
-                    copy = copy->par;
-                    down = false;
-                    continue;
-                }
-
-                if (head->rns != nullptr) {
-                    prev = head;
                     head = head->rns;
-
-                    *copy->rns = copy_node_(head);
-                    copy = copy->rns;
-                    down = true;
                     continue;
                 }
 
-                prev = head;
-                head = head->par;
+                head = head == node ? nullptr : head->par;
                 copy = copy->par;
-                down = false;
             }
-        }
 
+            return root;
+        }
 
         void free_node_(rmq_node *node) {
             if (node == nullptr)
@@ -1141,6 +1385,11 @@ namespace ex::data {
             release_node_(node);
         }
 
+        void release_node_(alloc_batch &batch, rmq_node *node) {
+            node->~rmq_node();
+            batch.put(node);
+        }
+
         void release_node_(rmq_node *node) {
             if (node == nullptr)
                 return;
@@ -1149,6 +1398,8 @@ namespace ex::data {
         }
 
         void iterative_free_(rmq_node *const node) {
+            alloc_batch batch(allocator_, sizeof(rmq_node), alignof(rmq_node));
+
             rmq_node *head = node;
             rmq_node *prev = node;
             bool     down = true;
@@ -1170,7 +1421,7 @@ namespace ex::data {
                     prev = head;
                     head = head->par;
                     down = false;
-                    release_node_(prev);
+                    release_node_(batch, prev);
                     continue;
                 }
 
@@ -1184,7 +1435,7 @@ namespace ex::data {
                 prev = head;
                 head = head->par;
                 down = false;
-                release_node_(prev);
+                release_node_(batch, prev);
             }
         }
 
@@ -1226,6 +1477,87 @@ namespace ex::data {
             return head;
         }
 
+        /**
+         * In-order walk over the nodes with range value in [min, max], entering only overlapping subtrees
+         */
+        struct overlap_iterator {
+            enum class step_t : u_int8_t { enter, left_done, self_done, right_done };
+
+            const rmq_map *map_  = nullptr;
+            rmq_node      *head_ = nullptr;
+            rmq_t          min_{};
+            rmq_t          max_{};
+            step_t         step_ = step_t::enter;
+
+            overlap_iterator() = default;
+
+            overlap_iterator(const rmq_map *map, const rmq_t &min, const rmq_t &max):
+                map_(map), min_(min), max_(max) {
+                if (map->overlap_(map->root_, min, max))
+                    head_ = map->root_;
+                spin_();
+            }
+
+            rmq_node &operator * () const {
+                if (head_ == nullptr)
+                    abort_("");
+                return *head_;
+            }
+
+            rmq_node *operator -> () const {
+                return &(**this);
+            }
+
+            overlap_iterator &operator ++ () {
+                spin_();
+                return *this;
+            }
+
+            bool operator != (const overlap_iterator &other) const {
+                return head_ != other.head_;
+            }
+
+            bool operator == (const overlap_iterator &other) const {
+                return head_ == other.head_;
+            }
+
+            /**
+             * Stops on the next fitting node (step_ left at self_done), head_ is nullptr when done
+             */
+            void spin_() {
+                while (head_ != nullptr) {
+                    switch (step_) {
+                        case step_t::enter:
+                            if (map_->overlap_(head_->lns, min_, max_)) {
+                                head_ = head_->lns;
+                                continue;
+                            }
+                            [[fallthrough]];
+
+                        case step_t::left_done:
+                            step_ = step_t::self_done;
+                            if (map_->fits_(head_, min_, max_, nullptr, nullptr))
+                                return;
+                            [[fallthrough]];
+
+                        case step_t::self_done:
+                            if (map_->overlap_(head_->rns, min_, max_)) {
+                                head_ = head_->rns;
+                                step_ = step_t::enter;
+                                continue;
+                            }
+                            [[fallthrough]];
+
+                        case step_t::right_done: {
+                            rmq_node *parent = head_->par;
+                            step_ = (parent != nullptr && parent->lns == head_) ? step_t::left_done : step_t::right_done;
+                            head_ = parent;
+                        }
+                    }
+                }
+            }
+        };
+
         // DSF Post-Order iterator
         struct iterator {
 //            it_entry  entr_;
@@ -1318,7 +1650,7 @@ namespace ex::data {
 
         template <typename T>
         T *malloc_(void *, allocator &allocator, const std::size_t size_n) {
-            return static_cast<T *>(allocator.malloc(&allocator, size_n * sizeof(T), sizeof(T)));
+            return static_cast<T *>(allocator.malloc(&allocator, size_n * sizeof(T), alignof(T)));
         }
 
         template <typename T>
@@ -9,8 +9,15 @@
 
 namespace ex::data {
 
+    /**
+     * Sorted map with binary search over a sorted key array.
+     * <br/><br/>
+     * <b>freeze()</b> switches lookups to an Eytzinger (BFS order) copy of the keys: the search is a branchless
+     * descent <b>k = 2k + (key_k < key)</b> with the cache line four levels down prefetched.
+     * Modifications mark the copy dirty, the next lookup rebuilds it (so a dirty frozen map is not safe for concurrent readers).
+     */
     template<typename key_t, typename val_t>
-    struct sorted_map { // sorted map with binary tree search implementation
+    struct sorted_map {
 
         struct entry {
             key_t key;
@@ -29,6 +36,11 @@ namespace ex::data {
         const int &capacity = key_entries_.capacity;
         const int &size     = key_entries_.size;
 
+        mutable array<key_t>   eytz_keys_;  // [1, size], slot 0 unused
+        mutable array<int32_t> eytz_rank_;  // eytzinger slot -> sorted index
+        bool                   frozen_ = false;
+        mutable bool           dirty_  = false;
+
         ~sorted_map() = default;
 
         sorted_map(const comparator_fn compare = &default_comparator):
@@ -36,7 +48,7 @@ namespace ex::data {
         }
 
         sorted_map(const allocator &allocator_, const comparator_fn compare = &default_comparator) :
-            comparator__(compare), key_entries_(allocator_), val_entries_(allocator_) {
+            comparator__(compare), key_entries_(allocator_), val_entries_(allocator_), eytz_keys_(allocator_), eytz_rank_(allocator_) {
         }
 
         sorted_map(int capacity, const comparator_fn compare = &default_comparator) :
@@ -44,19 +56,28 @@ namespace ex::data {
         }
 
         sorted_map(int capacity, const allocator &allocator_, const comparator_fn compare = &default_comparator) :
-            comparator__(compare), key_entries_(capacity, allocator_), val_entries_(capacity, allocator_) {
+            comparator__(compare), key_entries_(capacity, allocator_), val_entries_(capacity, allocator_),
+            eytz_keys_(allocator_), eytz_rank_(allocator_) {
         }
 
         sorted_map(const sorted_map &src) :
             comparator__(src.comparator__),
             key_entries_(src.key_entries_),
-            val_entries_(src.val_entries_) {
+            val_entries_(src.val_entries_),
+            eytz_keys_(src.eytz_keys_),
+            eytz_rank_(src.eytz_rank_),
+            frozen_(src.frozen_),
+            dirty_(src.dirty_) {
         }
 
         sorted_map(sorted_map &&src) noexcept :
             comparator__(src.comparator__),
             key_entries_(static_cast<array<key_t> &&>(src.key_entries_)),
-            val_entries_(static_cast<array<val_t> &&>(src.val_entries_)) {
+            val_entries_(static_cast<array<val_t> &&>(src.val_entries_)),
+            eytz_keys_(static_cast<array<key_t> &&>(src.eytz_keys_)),
+            eytz_rank_(static_cast<array<int32_t> &&>(src.eytz_rank_)),
+            frozen_(src.frozen_),
+            dirty_(src.dirty_) {
         }
 
         sorted_map &operator = (const sorted_map &other) {
@@ -64,6 +85,10 @@ namespace ex::data {
                 return *this;
             key_entries_ = other.key_entries_;
             val_entries_ = other.val_entries_;
+            eytz_keys_   = other.eytz_keys_;
+            eytz_rank_   = other.eytz_rank_;
+            frozen_      = other.frozen_;
+            dirty_       = other.dirty_;
             comparator__ = other.comparator__;
             return *this;
         }
@@ -73,10 +98,36 @@ namespace ex::data {
                 return *this;
             key_entries_ = static_cast<array<key_t> &&>(other.key_entries_);
             val_entries_ = static_cast<array<val_t> &&>(other.val_entries_);
+            eytz_keys_   = static_cast<array<key_t> &&>(other.eytz_keys_);
+            eytz_rank_   = static_cast<array<int32_t> &&>(other.eytz_rank_);
+            frozen_      = other.frozen_;
+            dirty_       = other.dirty_;
             comparator__ = other.comparator__;
             return *this;
         }
 
+        /**
+         * Lays the keys out in Eytzinger order, lookups use it until thaw()
+         */
+        void freeze() {
+            frozen_ = true;
+            eytz_build_();
+        }
+
+        /**
+         * Drops the Eytzinger copy, lookups go back to the binary search
+         */
+        void thaw() {
+            frozen_ = false;
+            dirty_  = false;
+            eytz_keys_.clean();
+            eytz_rank_.clean();
+        }
+
+        bool frozen() const {
+            return frozen_;
+        }
+
         int binary_search(const key_t &key) const {
             return key_entries_.binary_search(key, comparator__);
         }
@@ -90,11 +141,12 @@ namespace ex::data {
             const int index = key_entries_.sort_insert_once(key, comparator__);
             if (old_size < size) val_entries_.insert(index, element);
             else                 val_entries_[index] = element;
+            dirty_ = dirty_ || (frozen_ && old_size < size);
         }
 
         int index_at(const key_t &key) const {
-            const int index = binary_search(key);
-            if (index < 0 || index >= size)
+            const int index = find_(key);
+            if (index < 0)
                 abort();
             return index;
         }
@@ -108,17 +160,11 @@ namespace ex::data {
         }
 
         val_t &at(const key_t &key) {
-            const int index = binary_search(key);
-            if (index < 0 || index >= size)
-                abort();
-            return val_entries_[index];
+            return val_entries_[index_at(key)];
         }
 
         const val_t &at(const key_t &key) const {
-            const int index = binary_search(key);
-            if (index < 0 || index >= size)
-                abort();
-            return val_entries_[index];
+            return val_entries_[index_at(key)];
         }
 
         const val_t &at_index(const int &index) const {
@@ -130,18 +176,11 @@ namespace ex::data {
         }
 
         bool contains(const key_t &key) const {
-            const int index = binary_search(key);
-            if (index < 0 || index >= size)
-                return false;
-            return true;
+            return find_(key) >= 0;
         }
 
         void collapse(const key_t &key) {
-            const int index = binary_search(key, comparator__);
-            if (index < 0 || index >= size)
-                return;
-            key_entries_.collapse(index);
-            val_entries_.collapse(index);
+            collapse_at_pos(find_(key));
         }
 
         void collapse_at_pos(const int &idx) {
@@ -149,6 +188,7 @@ namespace ex::data {
                 return;
             key_entries_.collapse(idx);
             val_entries_.collapse(idx);
+            dirty_ = frozen_;
         }
 
         bool empty() const {
@@ -158,6 +198,9 @@ namespace ex::data {
         void clean() {
             key_entries_.clean();
             val_entries_.clean();
+            eytz_keys_.clean();
+            eytz_rank_.clean();
+            dirty_ = false;
         }
 
         void reserve(const int n) {
@@ -166,6 +209,78 @@ namespace ex::data {
             key_entries_.reserve(n);
             val_entries_.reserve(n);
         }
+
+        // =========================================== INTERNAL UTILS ==================================================
+
+        /**
+         * Sorted index of the key or -1
+         */
+        int find_(const key_t &key) const {
+            if (frozen_)
+                return eytz_find_(key);
+            const int index = binary_search(key);
+            if (index < 0 || index >= size || comparator__(&key_entries_[index], &key) != 0)
+                return -1;
+            return index;
+        }
+
+        int eytz_find_(const key_t &key) const {
+            if (dirty_)
+                eytz_build_();
+            if (comparator__ == &default_comparator)
+                return eytz_search_(key, [](const key_t &a, const key_t &b) { return a < b; });
+            const comparator_fn compare = comparator__;
+            return eytz_search_(key, [compare](const key_t &a, const key_t &b) { return compare(&a, &b) < 0; });
+        }
+
+        /**
+         * Branchless lower bound: the comparison result picks the child, the slot left after the last right turn
+         * is the first key not less than <b>key</b>
+         */
+        template <typename F>
+        int eytz_search_(const key_t &key, const F less) const {
+            constexpr std::size_t line_n = sizeof(key_t) < 64 ? 64 / sizeof(key_t) : 1;
+
+            const key_t *keys = eytz_keys_.data;
+            const int    n    = size;
+            std::size_t  k    = 1;
+            while (k <= static_cast<std::size_t>(n)) {
+                __builtin_prefetch(keys + k * line_n); // descendants 4 levels down share a line (4 byte keys)
+                k = 2 * k + less(keys[k], key);
+            }
+            k >>= __builtin_ffsll(static_cast<long long>(~k));
+
+            if (k == 0 || less(key, keys[k]))
+                return -1;
+            return eytz_rank_[static_cast<int>(k)];
+        }
+
+        /**
+         * Slot to rank table first, then the keys are copy constructed slot by slot through the array API
+         * (old copies destroyed), so non-trivial keys are fine
+         */
+        void eytz_build_() const {
+            eytz_rank_.clear();
+            eytz_rank_.resize(size + 1);
+            int index = 0;
+            eytz_fill_(1, index);
+
+            eytz_keys_.clear();
+            eytz_keys_.reserve(size + 1);
+            if (size > 0)
+                eytz_keys_.push(key_entries_[0]); // slot 0 is never read, any key will do
+            for (int k = 1; k <= size; ++k)
+                eytz_keys_.push(key_entries_[eytz_rank_[k]]);
+            dirty_ = false;
+        }
+
+        void eytz_fill_(const int k, int &index) const {
+            if (k > size)
+                return;
+            eytz_fill_(2 * k, index);
+            eytz_rank_[k] = index++;
+            eytz_fill_(2 * k + 1, index);
+        }
     };
 
 }
@@ -123,9 +123,10 @@ namespace limbo::graph {
 
 #define DATA_INIT_CAP 8
 
-            ex::data::array<Description> in_descriptions_  = { DATA_INIT_CAP, memory::allocator };
-            ex::data::array<Description> out_descriptions_ = { DATA_INIT_CAP, memory::allocator };
-            bool                         freeze_ = false;
+            // ports live inline, the heap is touched only past DATA_INIT_CAP of them
+            ex::data::inline_array<Description, DATA_INIT_CAP> in_descriptions_  = { DATA_INIT_CAP, memory::allocator };
+            ex::data::inline_array<Description, DATA_INIT_CAP> out_descriptions_ = { DATA_INIT_CAP, memory::allocator };
+            bool                                               freeze_ = false;
 
             ~port_dispatcher() override = default;
 
@@ -284,13 +285,14 @@ namespace limbo::graph {
 
         virtual void on_init() { /*NOP*/ }
 
-        assignment_fn_t                      assignment_fn_ = nullptr;
-        ex::data::array_map<ushort, io_data> cache_map      = { NODE_INIT_CAP, memory::allocator };
-        ex::data::array_map<ushort, void *>  stack_map      = { NODE_INIT_CAP, memory::allocator };
-        ex::data::array<io_node>             connections    = { NODE_INIT_CAP, memory::allocator };
-        std::size_t                          id_            = 0;
-        unsigned int                         clock_i        = 0;
-        bool                                 initialized_   = false;
+        // inline up to NODE_INIT_CAP entries each, the heap is touched only by bigger nodes
+        assignment_fn_t                                            assignment_fn_ = nullptr;
+        ex::data::inline_array_map<ushort, io_data, NODE_INIT_CAP> cache_map      = { NODE_INIT_CAP, memory::allocator };
+        ex::data::inline_array_map<ushort, void *, NODE_INIT_CAP>  stack_map      = { NODE_INIT_CAP, memory::allocator };
+        ex::data::inline_array<io_node, NODE_INIT_CAP>             connections    = { NODE_INIT_CAP, memory::allocator };
+        std::size_t                                                id_            = 0;
+        unsigned int                                               clock_i        = 0;
+        bool                                                       initialized_   = false;
 
         ~BaseNode() override = default;
 
@@ -0,0 +1,199 @@
+//
+// Created by henryco on 17/10/26.
+//
+
+#include "../data/alloc/stackarena.h"
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+
+/**
+ * ABA / ownership stress of stackarena::concurrent_allocator, meant to be run under ThreadSanitizer as well
+ * (cmake -DLIMBO_SANITIZE=thread). Invariants checked on every operation:
+ * <br/> - a block is never handed out while it is owned (ownership table indexed by block index)
+ * <br/> - blocks lie inside their region and on a block boundary
+ * <br/> - nobody writes into an owned block but its owner (stamp checked before every release)
+ * <br/> - everything released at the end leaves the arena with no taken blocks
+ * Half of the releases go through the neighbour thread, part of them as batches.
+ */
+namespace {
+
+    constexpr std::size_t BLOCK_S   = 48;
+    constexpr int         HELD_MAX  = 256; // live blocks per thread
+    constexpr int         REGIONS_N = 64;  // ownership table covers this many regions
+
+    using arena_t = ex::data::stackarena::concurrent_allocator;
+
+    struct held_block {
+        void     *ptr;
+        u_int64_t stamp;
+    };
+
+    struct mailbox {
+        std::mutex              lock;
+        std::vector<held_block> blocks;
+    };
+
+    std::atomic<long> failures_{ 0 };
+
+    void fail_(const char *what, const void *ptr) {
+        if (failures_.fetch_add(1, std::memory_order_relaxed) < 16)
+            std::fprintf(stderr, "stackarena_stress: %s (%p)\n", what, ptr);
+    }
+
+    struct stress {
+        arena_t                                  arena_{ BLOCK_S, 64 * 1024 };
+        std::unique_ptr<std::atomic<u_int8_t>[]> owned_;
+        std::size_t                              owned_n_;
+
+        stress() :
+            owned_n_(static_cast<std::size_t>(REGIONS_N) * arena_.blocks_n) {
+            owned_ = std::make_unique<std::atomic<u_int8_t>[]>(owned_n_);
+        }
+
+        std::size_t index_of_(void *ptr) {
+            const auto *region = arena_.region_of_(ptr);
+            const auto *bytes  = static_cast<const unsigned char *>(ptr);
+            if (bytes < region->data || (bytes - region->data) % BLOCK_S != 0) {
+                fail_("block off the block grid", ptr);
+                return owned_n_;
+            }
+            const u_int32_t local = arena_.local_of_(region, ptr);
+            if (local >= arena_.blocks_n) {
+                fail_("block past the region end", ptr);
+                return owned_n_;
+            }
+            return static_cast<std::size_t>(region->id) * arena_.blocks_n + local;
+        }
+
+        void on_taken_(void *ptr, const u_int64_t stamp) {
+            const std::size_t index = index_of_(ptr);
+            if (index >= owned_n_)
+                return;
+            if (owned_[index].exchange(1, std::memory_order_acq_rel) != 0)
+                fail_("block handed out while owned", ptr);
+            auto *words = static_cast<u_int64_t *>(ptr);
+            for (std::size_t i = 0; i < BLOCK_S / sizeof(u_int64_t); ++i)
+                words[i] = stamp;
+        }
+
+        void on_release_(const held_block &block) {
+            const auto *words = static_cast<const u_int64_t *>(block.ptr);
+            for (std::size_t i = 0; i < BLOCK_S / sizeof(u_int64_t); ++i) {
+                if (words[i] != block.stamp) {
+                    fail_("owned block overwritten", block.ptr);
+                    break;
+                }
+            }
+            const std::size_t index = index_of_(block.ptr);
+            if (index < owned_n_ && owned_[index].exchange(0, std::memory_order_acq_rel) != 1)
+                fail_("block released while not owned", block.ptr);
+        }
+
+        void run(const int threads_n, const int ops_n) {
+            std::vector<mailbox>     boxes(threads_n);
+            std::vector<std::thread> threads;
+            std::atomic<int>         done_n{ 0 };
+
+            for (int t = 0; t < threads_n; ++t) {
+                threads.emplace_back([&, t] {
+                    std::mt19937            rng(static_cast<u_int32_t>(t) * 7919u + 1);
+                    std::vector<held_block> held;
+                    mailbox                &inbox = boxes[t];
+                    mailbox                &next  = boxes[(t + 1) % threads_n];
+                    u_int64_t               seq   = 0;
+                    void                   *batch[16];
+
+                    const auto take = [&](void *ptr) {
+                        const held_block block = { ptr, (static_cast<u_int64_t>(t + 1) << 48) | ++seq };
+                        on_taken_(ptr, block.stamp);
+                        held.push_back(block);
+                    };
+
+                    const auto drain = [&] {
+                        std::vector<held_block> foreign;
+                        {
+                            std::lock_guard guard(inbox.lock);
+                            foreign.swap(inbox.blocks);
+                        }
+                        for (const held_block &block : foreign) {
+                            on_release_(block);
+                            arena_.free(block.ptr);
+                        }
+                    };
+
+                    for (int op = 0; op < ops_n; ++op) {
+                        const u_int32_t dice = rng() % 16;
+                        if (dice == 0) {
+                            arena_.malloc_batch(16, BLOCK_S, 8, batch);
+                            for (void *ptr : batch)
+                                take(ptr);
+                        } else if (dice == 1 && held.size() >= 16) {
+                            for (int i = 0; i < 16; ++i) {
+                                batch[i] = held.back().ptr;
+                                on_release_(held.back());
+                                held.pop_back();
+                            }
+                            arena_.free_batch(batch, 16);
+                        } else if (dice < 9 && held.size() < HELD_MAX) {
+                            take(arena_.malloc(BLOCK_S, 8));
+                        } else if (!held.empty()) {
+                            const std::size_t i     = rng() % held.size();
+                            const held_block  block = held[i];
+                            held[i] = held.back();
+                            held.pop_back();
+                            if (dice % 2 == 0) {
+                                on_release_(block);
+                                arena_.free(block.ptr);
+                            } else {
+                                std::lock_guard guard(next.lock);
+                                next.blocks.push_back(block);
+                            }
+                        }
+                        if (op % 64 == 0)
+                            drain();
+                    }
+
+                    for (const held_block &block : held) {
+                        on_release_(block);
+                        arena_.free(block.ptr);
+                    }
+                    done_n.fetch_add(1, std::memory_order_acq_rel);
+                    while (done_n.load(std::memory_order_acquire) < threads_n)
+                        std::this_thread::yield();
+                    drain();
+                });
+            }
+
+            for (std::thread &thread : threads)
+                thread.join();
+
+            if (arena_.taken_n_.load(std::memory_order_relaxed) != 0)
+                fail_("blocks still taken after everything was released", nullptr);
+            for (std::size_t i = 0; i < owned_n_; ++i) {
+                if (owned_[i].load(std::memory_order_relaxed) != 0) {
+                    fail_("block still owned after everything was released", nullptr);
+                    break;
+                }
+            }
+        }
+    };
+}
+
+int main(const int argc, char **argv) {
+    const int ops_n     = argc > 1 ? std::atoi(argv[1]) : 200000;
+    const int hardware  = static_cast<int>(std::thread::hardware_concurrency());
+    const int threads_n = hardware > 4 ? (hardware < 16 ? hardware : 16) : 4;
+
+    auto test = std::make_unique<stress>();
+    test->run(threads_n, ops_n);
+
+    const long failures = failures_.load();
+    std::printf("stackarena_stress: %d threads x %d ops, %ld failures\n", threads_n, ops_n, failures);
+    return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}